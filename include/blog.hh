@@ -39,6 +39,95 @@ namespace tero {
 extern char blogPat[];
 extern const char *blogTrigger;
 
+extern pathVariable blogIndexDir;
+
+void
+blogAddSessionVars( boost::program_options::options_description& opts,
+    boost::program_options::options_description& visible );
+
+
+/** Metadata of the posts stored in the blog files under a directory.
+
+    For each post, the index records the fields used to select, sort
+    and list posts (guid, time, title, author, score, tags and other
+    headers) along with the byte range of the message in its file.
+    Listing pages feed those posts without their content through
+    their filters and only load the content of the posts that are
+    displayed (see blogContentLoader).
+
+    A file is parsed again only when its stamp (see
+    revisionsys::findRevContentId) changed. Indices live as long as
+    the process and, when *blogIndexDir* is set, are stored on disk
+    such that a new process does not parse every file again.
+*/
+class blogIndex {
+public:
+    struct entry {
+        /* post without its content */
+        post meta;
+        size_t offset;
+        size_t length;
+    };
+    typedef std::vector<entry> entryList;
+
+    struct fileEntry {
+        std::string stamp;
+        entryList posts;
+    };
+    typedef std::map<boost::filesystem::path,fileEntry> fileMap;
+
+protected:
+    std::string key;
+
+    fileMap files;
+
+    friend class blogIndexer;
+
+    boost::filesystem::path
+    storePath( const boost::filesystem::path& dir ) const;
+
+    bool load( const boost::filesystem::path& dir );
+
+    void store( const boost::filesystem::path& dir ) const;
+
+public:
+    /** Returns the index of the files matching *filePat* under
+        *blogroot*, updated for the files that changed since
+        it was last refreshed. When *recursive* is false, only
+        the files directly inside *blogroot* are indexed. */
+    static blogIndex& refresh( session& s,
+        const boost::filesystem::path& blogroot, const char *filePat,
+        bool recursive = true );
+
+    /** Passes the posts in the index, without their content,
+        to *filter*. When *firstOnly* is true, only the first post
+        of each file is passed. */
+    void feed( postFilter& filter, bool firstOnly = false ) const;
+
+    /** Loads the content of *p* out of the file it was indexed from.
+        Returns false if *p* cannot be found in the index. */
+    bool content( session& s, post& p ) const;
+};
+
+
+/** Loads the content of posts fed out of a blogIndex before
+    passing them to the next filter.
+*/
+class blogContentLoader : public passThruFilter {
+public:
+    typedef passThruFilter super;
+
+protected:
+    session *s;
+    const blogIndex *index;
+
+public:
+    blogContentLoader( session& ps, const blogIndex& i, postFilter* n )
+        : super(n), s(&ps), index(&i) {}
+
+    virtual void filters( const post& );
+};
+
 
 /**
    Splat a field by the number of comma separated values.
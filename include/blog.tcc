@@ -29,30 +29,32 @@ namespace tero {
 
 template<typename cmp>
 void blogSplat<cmp>::filters( const post& v ) {
-    post p = v;
     post::headersMap::const_iterator tags
-        = p.moreHeaders.find(cmp::name);
-    if( tags != p.moreHeaders.end() ) {
-        size_t first = 0, last = 0;
-        while( last != tags->second.size() ) {
-            if( tags->second[last] == ',' ) {
-                std::string s
-                    = strip(tags->second.substr(first,last-first));
-                if( !s.empty() ) {
-                    p.tag = s;
-                    next->filters(p);
-                }
-                first = last + 1;
+        = v.moreHeaders.find(cmp::name);
+    if( tags == v.moreHeaders.end() ) {
+        next->filters(v);
+        return;
+    }
+    /* The copy shares its content with *v*, only the tag changes
+       from one forwarded post to the next. */
+    post p = v;
+    size_t first = 0, last = 0;
+    while( last != tags->second.size() ) {
+        if( tags->second[last] == ',' ) {
+            std::string s
+                = strip(tags->second.substr(first,last-first));
+            if( !s.empty() ) {
+                p.tag = s;
+                next->filters(p);
             }
-            ++last;
+            first = last + 1;
         }
-        std::string s
-            = strip(tags->second.substr(first,last-first));
-        if( !s.empty() ) {
-            p.tag = s;
-            next->filters(p);
-        }
-    } else {
+        ++last;
+    }
+    std::string s
+        = strip(tags->second.substr(first,last-first));
+    if( !s.empty() ) {
+        p.tag = s;
         next->filters(p);
     }
 }
@@ -115,17 +117,33 @@ void blogByInterval( session& s, const url& name )
               << "(from " << lower.tag << " to " << upper.tag << ")"
               << std::endl;
 #endif
-    blogInterval<cmp> interval(&writer,lower,upper);
+    /* Posts are listed from the content directory of the page,
+       or its nearest existing parent, without descending into
+       sub-directories. */
+    boost::filesystem::path base(s.abspath(name));
+    while( base.string().size() > siteTop.value(s).string().size()
+        && !boost::filesystem::is_directory(base) ) {
+        base = base.parent_path();
+    }
+    const blogIndex& index = blogIndex::refresh(s, base, filePat, false);
+
+    /* Only the posts in the interval get their content loaded. */
+    blogContentLoader content(s, index, &writer);
+    blogInterval<cmp> interval(&content,lower,upper);
     blogSplat<cmp> feeds(&interval);
     if( !s.feeds ) {
         s.feeds = &feeds;
     }
 
-    feedContent<defaultWriter,filePat>(s,s.abspath(name));
-
     if( s.feeds == &feeds ) {
+        index.feed(*s.feeds, true);
         s.feeds->flush();
         s.feeds = NULL;
+    } else {
+        /* The posts are retained further down an enclosing feed
+           which might write any of them. */
+        blogContentLoader loaded(s, index, s.feeds);
+        index.feed(loaded, true);
     }
 }
 
@@ -196,15 +214,14 @@ void blogSetLinksFetch( session& s, const url& name )
         s.feeds = &feeds;
     }
 
-    /* workaround Ubuntu/gcc-4.4.3 is not happy with boost::regex(filePat)
-       passed as parameter to parser. */
-    boost::regex pat(filePat);
-    mailParser parser(pat,*s.feeds,false);
-    parser.fetch(s, blogroot);
+    /* Counting posts does not require their content. */
+    const blogIndex& index = blogIndex::refresh(s, blogroot, filePat);
+    index.feed(*s.feeds);
+    s.feeds->flush();
 
     if( s.feeds == &feeds ) {
 #if 0
-        // XXX There is already one flush() in parser.fetch().
+        // XXX There is already one flush() right after feeding the index.
         // Another one here would show the tags repeated twice.
         s.feeds->flush();
 #endif
@@ -237,8 +254,7 @@ void blogRelatedSubjects( session& s, const url& name )
         /* If *name* is not a regular file, we will build a list
            of posts related to the most recent post. */
         mostRecentFilter mostRecent(NULL);
-        mailParser walker(boost::regex(blogPat), mostRecent, true);
-        walker.fetch(s, blogroot);
+        blogIndex::refresh(s, blogroot, blogPat).feed(mostRecent, true);
         p = mostRecent.mostRecent();
     } else {
         boost::filesystem::path related = name.pathname;
@@ -246,7 +262,7 @@ void blogRelatedSubjects( session& s, const url& name )
         mailAsPost listener;
         rfc2822Tokenizer tok(listener);
         tok.tokenize(text.begin(),text.size());
-        p = listener.unserialized();
+        listener.unserialized(p);
     }
 
     typename feedSelect<orderByTag<post> >::matchKeySet tags;
@@ -271,11 +287,10 @@ void blogRelatedSubjects( session& s, const url& name )
         s.feeds = &feeds;
     }
 
-    /* workaround Ubuntu/gcc-4.4.3 is not happy with boost::regex(filePat) 
-       passed as parameter to parser. */
-    boost::regex pat(filePat);
-    mailParser parser(pat,*s.feeds,false);
-    parser.fetch(s,blogroot);
+    /* Subjects are written out of the index without loading posts. */
+    const blogIndex& index = blogIndex::refresh(s, blogroot, filePat);
+    index.feed(*s.feeds);
+    s.feeds->flush();
 
     if( s.feeds == &feeds ) {
         s.feeds->flush();
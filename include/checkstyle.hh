@@ -26,6 +26,12 @@
 #ifndef guardcheckstyle
 #define guardcheckstyle
 
+#include <deque>
+#include <ctime>
+#include <map>
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/tr1/memory.hpp>
 #include "slice.hh"
 #include "tokenize.hh"
 #include "decorator.hh"
@@ -89,6 +95,12 @@ public:
                 licenseType(unknownLicense),
                 nbLines(0), nbCodeLines(0) {}
 
+    virtual ~checker() {}
+
+    /** Checks the *n* characters of *line*. The character 
+        at line[n] must be readable. */
+    virtual size_t tokenize( const char *line, size_t n ) = 0;
+
     licenseCode license() {
         if( !cached ) cache();
         return licenseType;
@@ -116,7 +128,7 @@ public:
     virtual void token( cppToken token, const char *line,
         int first, int last, bool fragment );
 
-    size_t tokenize( const char *line, size_t n ) {
+    virtual size_t tokenize( const char *line, size_t n ) {
         return tokenizer.tokenize(line,n);
     }
 };
@@ -136,12 +148,75 @@ public:
     virtual void token( shToken token, const char *line,
         int first, int last, bool fragment );
 
-    size_t tokenize( const char *line, size_t n ) {
+    virtual size_t tokenize( const char *line, size_t n ) {
         return tokenizer.tokenize(line,n);
     }
 };
 
 
+/** Runs checkers on a pool of worker threads.
+
+    The main thread copies the texts to check into the pool as long 
+    as the total size of the texts in flight stays under a budget.
+    Rows are written by the main thread in the order the files were
+    submitted, as soon as their checker completed.
+*/
+class checkPool {
+protected:
+    struct job {
+        checker *check;
+        std::vector<char> text;
+        url name;
+        bool done;
+        std::string error;
+    };
+    typedef std::deque<job*> jobQueue;
+
+    session& s;
+    size_t budget;
+    size_t inflight;
+    bool stopping;
+
+    /* Jobs in submission order, until their row is written. */
+    jobQueue submitted;
+
+    /* Jobs not yet picked up by a worker. */
+    jobQueue pending;
+
+    boost::mutex mutex;
+    boost::condition_variable ready;
+    boost::condition_variable checked;
+    boost::thread_group workers;
+
+    void work();
+
+    /** Writes the rows of the checked jobs, in order, waiting
+        for the jobs ahead to complete as long as more than 
+        *maxInflight* bytes of text are in flight. */
+    void writeRows( size_t maxInflight );
+
+public:
+    /** While a pool exists, checkfileFetch submits files to it
+        instead of checking them right away. */
+    static checkPool *current;
+
+    checkPool( session& s, size_t nbWorkers, size_t budget );
+
+    ~checkPool();
+
+    /** Checks *text* with *check* and writes the row for *name*
+        after the rows of the files submitted before. The pool takes
+        ownership of *check*. */
+    void submit( checker *check, const slice<char>& text, const url& name );
+
+    /** Writes the rows of all files submitted so far. */
+    void flush() { writeRows(0); }
+};
+
+
+/** Writes the table row for the file *name* checked by *check*. */
+void checkfileRow( session& s, checker& check, const url& name );
+
 template<typename checker>
 void checkfileFetch( session& s, const slice<char>& text, const url& name );
 
@@ -162,22 +237,71 @@ void checkstyleFetch( session&s, const url& name );
 
 
 
+/** Lint (or compiler) messages of a log, indexed by source file.
+
+    The log is read and tokenized once. Messages are kept as offsets
+    into the log text and grouped per file such that annotating
+    a source file is a lookup rather than a parse of the whole log.
+*/
+class lintIndex {
+public:
+    typedef std::tr1::shared_ptr<const lintIndex> pointer_type;
+
+protected:
+    struct note {
+        size_t file;
+        int line;
+        size_t first;
+        size_t last;
+    };
+    typedef std::vector<note> noteList;
+
+    /* file name -> [first,last) range in *notes* */
+    typedef std::map<std::string,std::pair<size_t,size_t> > fileMap;
+
+    static bool fileLess( const note& left, const note& right ) {
+        return left.file < right.file;
+    }
+
+    std::vector<char> text;
+    noteList notes;
+    fileMap files;
+    std::time_t mtime;
+
+    friend class lintIndexer;
+
+public:
+    explicit lintIndex( std::istream& log );
+
+    /** Returns the index of the log at *pathname*, building it only
+        when the log was modified since it was last indexed. Indices
+        of the most recently used logs are kept in memory. */
+    static pointer_type find( const boost::filesystem::path& pathname );
+
+    /** Adds the messages about *key* to *annotations*, by line. */
+    void annotations( std::map<int,std::string>& annotations,
+        const boost::filesystem::path& key ) const;
+};
+
+
+/** Annotates a source file with the messages about it
+    in a lint (or compiler) log.
+*/
 class lintAnnotate  : public noteDecorator {
 protected:
     typedef noteDecorator super;
 
-    void init( session& s,
-        const boost::filesystem::path& key,
-        std::istream& info );
+    void init( const boost::filesystem::path& key,
+        const boost::filesystem::path& logPath );
 
 public:
-    lintAnnotate( session& s,
-        const boost::filesystem::path& key,
-        std::istream& info );
+    /** Annotates *key* with the messages found in the log
+        at *logPath*, through the cached lintIndex. */
+    lintAnnotate( const boost::filesystem::path& key,
+        const boost::filesystem::path& logPath );
 
-    lintAnnotate( session& s,
-        const boost::filesystem::path& key,
-        std::istream& info,
+    lintAnnotate( const boost::filesystem::path& key,
+        const boost::filesystem::path& logPath,
         std::basic_ostream<char>& o );
 
     bool empty() const {
@@ -23,34 +23,18 @@
    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
-#include "markup.hh"
-#include "revsys.hh"
-
 namespace tero {
 
 template<typename checker>
 void checkfileFetch( session& s, const slice<char>& text, const url& name )
 {
-    using namespace boost::filesystem;
-
+    if( checkPool::current != NULL ) {
+        checkPool::current->submit(new checker, text, name);
+        return;
+    }
     checker check;
     check.tokenize(text.begin(), text.size());
-
-    path pathname = s.abspath(name);
-    revisionsys *rev = revisionsys::findRev(s, pathname);
-    path filename = rev ? rev->relative(pathname) : name.pathname;
-
-    s.out() << html::tr()
-            << html::td() << html::a().href(name)
-            << filename << html::a::end << html::td::end
-            << html::td() << check.license();
-    if( !check.grantor.empty() ) {
-        s.out() << " (" << check.dates << "," << check.grantor << ")";
-    }
-    s.out() << html::td::end
-            << html::td() << check.nbCodeLines << html::td::end
-            << html::td() << check.nbLines << html::td::end
-            << html::tr::end;
+    checkfileRow(s, check, name);
 }
 
 }
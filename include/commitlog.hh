@@ -0,0 +1,128 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef guardcommitlog
+#define guardcommitlog
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/filesystem/path.hpp>
+#include "gitobjects.hh"
+
+/** Index of the commits in a git repository.
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace tero {
+
+/** Persistent index of the commits reachable from HEAD.
+
+    For each commit, the index records its author, time, message
+    and the paths it touched, as well as which commits touched a path.
+    The index is built by walking the object database and is updated
+    incrementally from the HEAD it was last built at. When HEAD
+    is no longer a descendant of that commit (rewritten history),
+    the index is built again from scratch.
+*/
+class commitLog {
+public:
+    struct entry {
+        /** hexadecimal commit id */
+        std::string id;
+
+        /** author time in seconds since the epoch */
+        long long time;
+
+        std::string authorName;
+
+        std::string authorEmail;
+
+        /** full commit message */
+        std::string message;
+
+        /** files added, removed or modified by the commit. Merges also
+            record the directories, with a trailing '/', that differ
+            from all parents. */
+        std::vector<std::string> paths;
+
+        entry() : time(0) {}
+
+        /** first line of the commit message */
+        std::string title() const;
+    };
+
+    /** Commits sorted by decreasing time. */
+    typedef std::vector<entry> entrySet;
+
+    typedef std::vector<const entry*> entryRefs;
+
+protected:
+    typedef std::map<std::string,std::vector<size_t> > pathIndex;
+
+    /** commit HEAD pointed to when the index was last updated */
+    std::string head;
+
+    entrySet commits;
+
+    /** indices in *commits* of the commits that touched a path */
+    pathIndex byPath;
+
+    void reindex();
+
+    bool parseCommit( const gitObjects::buffer& data, entry& commit,
+        std::string& tree, std::vector<std::string>& parents ) const;
+
+    void diffTrees( gitObjects& objects, const std::string& prefix,
+        const gitObjects::objectId& left, const gitObjects::objectId& right,
+        std::set<std::string>& changed, bool dirs ) const;
+
+public:
+    /** Loads an index previously saved in *pathname*. */
+    bool load( const boost::filesystem::path& pathname );
+
+    /** Saves the index in *pathname*, creating its directory
+        if necessary. */
+    bool save( const boost::filesystem::path& pathname ) const;
+
+    /** Adds the commits reachable from the current HEAD
+        of the repository to the index. Returns false if the object
+        database cannot be read. *changed* is set to true
+        when commits were added. */
+    bool update( gitObjects& objects, bool& changed );
+
+    const entrySet& entries() const { return commits; }
+
+    /** Commits, most recent first, that touched *pathname* or a file
+        underneath it when *pathname* is a directory. An empty
+        *pathname* stands for the whole repository. */
+    void history( const std::string& pathname, entryRefs& results ) const;
+};
+
+}
+
+#endif
@@ -54,6 +54,11 @@ void compose( session& s, const url& name );
 void compose( session& s, std::istream& strm,
     const boost::filesystem::path& fixed );
 
+/** Use the template file *fixed*, compiled once per version of the file,
+    to display the document.
+ */
+void compose( session& s, const boost::filesystem::path& fixed );
+
 }
 
 #include "composer.tcc"
@@ -45,12 +45,7 @@ void compose( session& s, const url& name )
     path fixed(themeDir.value(s) /
         (!layout.empty() ? layout : name.pathname.filename()));
 
-    std::streambuf *buf = revisionsys::findRevOpenfile(s, fixed);
-    if( buf ) {
-        std::istream strm(buf);
-        compose(s, strm, fixed);
-        delete buf;
-    }
+    compose(s, fixed);
 }
 
 }
@@ -27,6 +27,7 @@
 #define guarddecorator
 
 #include <ostream>
+#include <vector>
 #include "session.hh"
 #include "tokenize.hh"
 
@@ -61,18 +62,73 @@ protected:
 
 	typedef std::basic_ostream<charT, traitsT> super;
 
+    /** Unbuffered entry point of a decorator inside a fused chain.
+	Text written to it is decorated in place by *transform()*. */
+    class transformBuf : public std::basic_streambuf<charT, traitsT> {
+    protected:
+	typedef typename traitsT::int_type int_type;
+
+	basicDecorator& decorator;
+
+	std::streamsize xsputn( const charT *s, std::streamsize n ) {
+	    decorator.transform(s,n);
+	    return n;
+	}
+
+	int_type overflow( int_type c ) {
+	    if( !traitsT::eq_int_type(c, traitsT::eof()) ) {
+		/* Tokenizers might look at the character that follows. */
+		charT text[2] = { traitsT::to_char_type(c), charT() };
+		decorator.transform(text,1);
+	    }
+	    return traitsT::not_eof(c);
+	}
+
+	int sync() { return decorator.sync(); }
+
+    public:
+	explicit transformBuf( basicDecorator& d ) : decorator(d) {}
+    };
+
     std::basic_streambuf<charT, traitsT>* nextBuf;
     std::basic_ostream<charT, traitsT> *next;
 
+    /** In a fused chain, the decorator that decorates the text 
+	written to *nextBuf* and the buffer markup is written to. */
+    basicDecorator *downstream;
+    std::basic_streambuf<charT, traitsT>* markupBuf;
+    transformBuf input;
+
 	bool pre;
 
+    /** Number of characters the decorator buffers, at most, before
+	it decorates them without waiting for the stream to be flushed.
+	Zero means the text is buffered until the next flush. */
+    size_t highWaterMark;
+
 public:
+    enum { defaultHighWaterMark = 64 * 1024 };
+
     explicit basicDecorator( std::basic_streambuf<charT,traitsT> *sb, 
 			     bool formated = false )
-	: super(sb), nextBuf(sb), next(NULL), pre(formated) {
+	: super(sb), nextBuf(sb), next(NULL), 
+	  downstream(NULL), markupBuf(NULL), input(*this), pre(formated),
+	  highWaterMark(defaultHighWaterMark) {
     }
     
     virtual ~basicDecorator() {}
+
+    /** Writes *n* characters of markup added by the decorator.
+	In a fused chain, markup bypasses the decorators that follow
+	since they would copy it as is. */
+    void markup( const charT *s, std::streamsize n ) {
+	if( downstream != NULL ) {
+	    downstream->boundary();
+	    markupBuf->sputn(s,n);
+	} else {
+	    nextBuf->sputn(s,n);
+	}
+    }
     
     /** \brief Attach the decorator to a basic_ostream
 	
@@ -87,6 +143,28 @@ public:
 	the text sent to the basic_ostream.
     */
     virtual void detach() = 0;
+
+    /** Decorates *n* characters of text produced by the previous
+	decorator in a fused chain. */
+    virtual void transform( const charT *text, size_t n ) {
+	nextBuf->sputn(text,n);
+    }
+
+    /** Markup from a previous decorator in a fused chain is about
+	to be written past this decorator. Text held so far is written
+	out and the decorator gets back to the state it would be in 
+	after copying the markup. */
+    virtual void boundary() {
+	if( downstream != NULL ) downstream->boundary();
+    }
+
+    virtual int sync() { 
+	return ( nextBuf != NULL ) ? nextBuf->pubsync() : 0; 
+    }
+
+    /** Sets the number of characters buffered before they are
+	decorated (see *highWaterMark*). */
+    virtual void highWater( size_t n ) { highWaterMark = n; }
     
     /** True when the decorator formats the underlying stream layout.
 	
@@ -101,6 +179,15 @@ public:
 
 
 /** \brief Composite for attaching multiple decorators as a single decorator.
+
+    In fused mode, only the first decorator buffers the text written
+    to the stream and tokenizes it. The text it produces is passed 
+    in place to the tokenizer of the next decorator while the markup
+    it adds (see *markup()*) goes straight to the stream's buffer.
+    The decorators that follow the first one thus only tokenize
+    the parts of the text they can change, without intermediate 
+    buffers. This assumes they copy markup from the previous ones
+    as is, which link and annotation decorators do.
  */
 template<typename charT, typename traitsT>
 class basicDecoratorChain : public basicDecorator<charT, traitsT> {
@@ -110,8 +197,14 @@ protected:
 	super *first;
 	super *last;
 
+	/** decorators in the order they were added */
+	std::vector<super*> links;
+
+	bool fused;
+
 public:
-	basicDecoratorChain() : super(NULL), first(NULL), last(NULL) {}
+	explicit basicDecoratorChain( bool f = false )
+	    : super(NULL), first(NULL), last(NULL), fused(f) {}
 
 	virtual ~basicDecoratorChain();
 
@@ -121,6 +214,8 @@ public:
 
 	void push_back( basicDecorator<charT, traitsT>& );
 
+	void highWater( size_t n );
+
 };
 
 
@@ -132,13 +227,22 @@ class basicHighLight : public basicDecorator<charT, traitsT> {
 protected:
 	typedef basicDecorator<charT, traitsT> super;
 
-private:
     class buffer : public std::basic_stringbuf<charT, traitsT> {
+    protected:
+	typedef std::basic_stringbuf<charT, traitsT> base;
+	typedef typename traitsT::int_type int_type;
+
+	int_type overflow( int_type c );
+
+	/** Decorates the text buffered so far up to its last line
+	    break and gives back the space to the string buffer. */
+	void spill();
+
     public:
 	using std::basic_stringbuf<charT, traitsT>::gbump;
 	using std::basic_stringbuf<charT, traitsT>::gptr;
 	using std::basic_stringbuf<charT, traitsT>::pptr;
-	
+
 	explicit buffer( basicHighLight& d ) 
 	    : std::basic_stringbuf<charT, traitsT>(),
 	      decorator(d) {}
@@ -150,10 +254,23 @@ private:
 
    buffer buf;
 
-protected:
     tokenizerT tokenizer;
     
+    /** Decorates the text written since the last flush
+	and consumes it. */
     void scan();
+
+    /** Decorates *n* characters of *text*. The text written to 
+	the stream can be split between calls at any character. Derived 
+	classes can override this method with a specialized loop as long 
+	as the output stays the same. */
+    virtual void tokenize( const charT *text, size_t n ) {
+	tokenizer.tokenize(text,n);
+    }
+
+    void transform( const charT *text, size_t n ) {
+	tokenize(text,n);
+    }
     
 public:
     explicit basicHighLight( bool formated );
@@ -180,15 +297,30 @@ class basicHtmlEscaper : public basicHighLight<xmlEscTokenizer, charT, traitsT>,
 protected:
     typedef basicHighLight<xmlEscTokenizer, charT, traitsT> super;
 
+    /* A '\r' ended the text scanned so far. Whether it is copied as is
+       or turned into a '\n' depends on the next character. */
+    bool pendingCR;
+
+    void tokenize( const char *text, size_t n );
+
 public:
     basicHtmlEscaper() 
-		: super(true) { 
+		: super(true), pendingCR(false) { 
 		super::tokenizer.attach(*this);
     }
     
     explicit basicHtmlEscaper(  std::basic_ostream<charT,traitsT>& o )
-	: super(o,true) { super::tokenizer.attach(*this); }
-    
+	: super(o,true), pendingCR(false) { super::tokenizer.attach(*this); }
+
+    ~basicHtmlEscaper() { detach(); }
+
+    /** When true (the default), text is escaped by skipping
+	to the next special character with scanFirstOf instead of going 
+	through the xmlEscTokenizer. Both paths produce the same output. */
+    static bool vectorized;
+
+    void detach();
+
     void newline( const char *line, int first, int last ) {
 		super::nextBuf->sputc('\n');
     }
@@ -224,16 +356,29 @@ protected:
     session* context;
     boost::filesystem::path base;
 
+    /* Names and attribute values split between calls to the tokenizer 
+       are put back together before they are categorized. */
+    xmlToken pendingToken;
+    std::string pending;
+
     /** returns true if the orginal text needs to be copied to the output
 	stream and false if the method replaced the text already. */
     virtual bool decorate( const url& u );
 
+    void categorize( xmlToken token, const char *line, int first, int last );
+
+    void flush();
+
 public:
     typedef std::set<url> linkSet;
     static linkSet allLinks;
     static linkSet currs;
     static linkSet nexts;
 
+    /** When not NULL, all links to local files found while generating
+        a page are also recorded here, visited before or not. */
+    static linkSet *pageLinks;
+
     static linkSet::const_iterator begin() { return currs.begin(); }
 
     static linkSet::const_iterator end() { return currs.end(); }
@@ -248,19 +393,32 @@ public:
 
     linkClass add( const url& u );
 
+    /** Records a link to the local file *f* found while generating
+	the current page. */
+    static void record( const url& f );
+
 public:
     explicit basicLinkLight( session& s, const boost::filesystem::path& r )
-        : super(false), context(&s), base(r) {
+        : super(false), state(linkStartState), context(&s), base(r),
+	  pendingToken(xmlErr) {
 	super::tokenizer.attach(*this);
     }
     
     basicLinkLight(  session& s, const boost::filesystem::path& root,
         std::basic_ostream<charT,traitsT>& o )
-        : super(o,false), context(&s), base(root) {
+        : super(o,false), state(linkStartState), context(&s), base(root),
+	  pendingToken(xmlErr) {
         super::tokenizer.attach(*this);
     }
+
+    ~basicLinkLight() { detach(); }
+
+    void boundary();
+
+    void detach();
     
     void newline( const char *line, int first, int last ) {
+	flush();
 	super::nextBuf->sputc('\n');
     }
     
@@ -43,6 +43,20 @@ void basicDecoratorChain<charT,traitsT>::attach(
 {
     if( last ) {
         assert( first != NULL );
+        if( fused ) {
+            /* The first decorator takes over the stream. Each decorator
+               writes its text to the next one and its markup to
+               the stream's original buffer. */
+            std::basic_streambuf<charT, traitsT> *original
+                = o.rdbuf(first->rdbuf());
+            for( super *l = first; l != NULL; l = l->downstream ) {
+                l->next = &o;
+                l->nextBuf = ( l->downstream != NULL ) ?
+                    &l->downstream->input : original;
+                l->markupBuf = original;
+            }
+            return;
+        }
         last->next = &o;
         last->nextBuf = o.rdbuf(first->rdbuf());
     }
@@ -53,6 +67,18 @@ template<typename charT, typename traitsT>
 void basicDecoratorChain<charT,traitsT>::detach()
 {
     if( last ) {
+        if( fused ) {
+            /* Each decorator writes out the text it holds to the next
+               one. The last one gives the original buffer back
+               to the stream. */
+            for( super *l = first; l != NULL; l = l->downstream ) {
+                l->detach();
+            }
+            return;
+        }
+        /* Text still buffered upstream goes through the whole chain
+           before the stream is given back. */
+        first->flush();
         last->detach();
     }
 }
@@ -63,15 +89,31 @@ void basicDecoratorChain<charT,traitsT>::push_back(
         basicDecorator<charT, traitsT>& d )
 {
     if( first ) {
-        d.attach(*first);
+        if( fused ) {
+            d.downstream = first;
+        } else {
+            d.attach(*first);
+        }
     } else {
         last = &d;
     }
     first = &d;
+    links.push_back(&d);
     super::pre |= d.formated();
 }
 
 
+template<typename charT, typename traitsT>
+void basicDecoratorChain<charT,traitsT>::highWater( size_t n )
+{
+    super::highWater(n);
+    for( typename std::vector<super*>::iterator l = links.begin();
+         l != links.end(); ++l ) {
+        (*l)->highWater(n);
+    }
+}
+
+
 template<typename tokenizerT, typename charT, typename traitsT>
 basicHighLight<tokenizerT,charT,traitsT>::~basicHighLight() {
     detach();
@@ -130,11 +172,118 @@ int basicHighLight<tokenizerT,charT,traitsT>::sync() {
 template<typename tokenizerT, typename charT, typename traitsT>
 void basicHighLight<tokenizerT,charT,traitsT>::scan() {
     int size = std::distance(buf.gptr(), buf.pptr());
-    tokenizer.tokenize(buf.gptr(),size);
+    tokenize(buf.gptr(),size);
     buf.gbump(size);
 }
 
 
+template<typename tokenizerT, typename charT, typename traitsT>
+void basicHighLight<tokenizerT,charT,traitsT>::buffer::spill() {
+    charT *first = this->gptr();
+    charT *last = this->pptr();
+    /* Text is cut after the last line break such that tokens are
+       only split as fragments when a single line is longer than 
+       the high-water mark. At least one character is kept as 
+       lookahead for the tokenizer. */
+    charT *cut = last - 1;
+    while( cut > first && cut[-1] != '\n' ) --cut;
+    if( cut == first ) cut = last - 1;
+    if( cut > first ) {
+        std::basic_string<charT, traitsT> rest(cut, last);
+        decorator.tokenize(first, std::distance(first, cut));
+        /* The string keeps its capacity so the memory used stays
+           bounded by the high-water mark. */
+        this->str(std::basic_string<charT, traitsT>());
+        base::xsputn(rest.data(), rest.size());
+    }
+}
+
+
+template<typename tokenizerT, typename charT, typename traitsT>
+typename basicHighLight<tokenizerT,charT,traitsT>::buffer::int_type
+basicHighLight<tokenizerT,charT,traitsT>::buffer::overflow( int_type c )
+{
+    /* The string buffer is full. Instead of growing it further,
+       the text is decorated once there is enough of it. Tokens
+       cut here are carried over as fragments. */
+    size_t size = std::distance(this->gptr(), this->pptr());
+    if( decorator.highWaterMark > 0
+        && size >= decorator.highWaterMark ) {
+        spill();
+    }
+    return base::overflow(c);
+}
+
+
+template<typename charT, typename traitsT>
+bool basicHtmlEscaper<charT,traitsT>::vectorized = true;
+
+
+template<typename charT, typename traitsT>
+void basicHtmlEscaper<charT,traitsT>::detach() {
+    if( super::next != NULL ) {
+        super::sync();
+        if( pendingCR ) {
+            /* No character follows the '\r', same as a '\r' followed 
+               by anything but '\n'. */
+            super::nextBuf->sputc('\n');
+            pendingCR = false;
+        }
+    }
+    super::detach();
+}
+
+
+template<typename charT, typename traitsT>
+void basicHtmlEscaper<charT,traitsT>::tokenize( const char *text, size_t n ) {
+    if( !vectorized ) {
+        super::tokenize(text,n);
+        return;
+    }
+    /* Characters that xmlEscTokenizer does not forward as escData.
+       A '\0' terminates the text, same as it does for the tokenizer. */
+    static const char stops[] = { '<', '>', '&', '"', '\r', '\0' };
+    const char *p = text;
+    const char *last = text + n;
+    if( pendingCR && p != last ) {
+        super::nextBuf->sputc(*p == '\n' ? '\r' : '\n');
+        pendingCR = false;
+    }
+    while( p != last ) {
+        const char *q = scanFirstOf(p,last,stops,sizeof(stops));
+        if( q != p ) super::nextBuf->sputn(p,q - p);
+        if( q == last ) break;
+        switch( *q ) {
+        case '<':
+            super::nextBuf->sputn("&lt;",4);
+            break;
+        case '>':
+            super::nextBuf->sputn("&gt;",4);
+            break;
+        case '&':
+            super::nextBuf->sputn("&amp;",5);
+            break;
+        case '"':
+            super::nextBuf->sputn("&quot;",6);
+            break;
+        case '\r':
+            /* "\r\n" are copied as is while a lone '\r' becomes 
+               a newline. */
+            if( q + 1 == last ) {
+                pendingCR = true;
+            } else {
+                super::nextBuf->sputc(q[1] == '\n' ? '\r' : '\n');
+            }
+            break;
+        default:
+            q = last - 1;
+            break;
+        }
+        p = q + 1;
+    }
+}
+
+
 template<typename charT, typename traitsT>
 void basicHtmlEscaper<charT,traitsT>::token( xmlEscToken token,
     const char *line,
@@ -173,6 +322,10 @@ template<typename charT, typename traitsT>
 typename basicLinkLight<charT,traitsT>::linkSet
 basicLinkLight<charT,traitsT>::nexts;
 
+template<typename charT, typename traitsT>
+typename basicLinkLight<charT,traitsT>::linkSet
+*basicLinkLight<charT,traitsT>::pageLinks = NULL;
+
 
 template<typename charT, typename traitsT>
 typename basicLinkLight<charT,traitsT>::linkClass
@@ -187,15 +340,7 @@ basicLinkLight<charT,traitsT>::add( const url& u ) {
         if( context->prefix(base, context->abspath(u)) ) { /* XXX In case it is not an "always" generated link. */
             url f = context->asUrl(context->abspath(u));
             result = localFileExists;
-            if( allLinks.find(f) == allLinks.end()
-                && currs.find(f) == currs.end() ) {
-                /* we have never seen that vertex before (i.e. white)
-                   so let's add it to the list of successors to process. */
-#if 0
-                std::cerr << ", add " << f;
-#endif
-                nexts.insert(f);
-            }
+            record(f);
         }
     }
 #if 0
@@ -205,6 +350,21 @@ basicLinkLight<charT,traitsT>::add( const url& u ) {
 }
 
 
+template<typename charT, typename traitsT>
+void basicLinkLight<charT,traitsT>::record( const url& f ) {
+    if( pageLinks ) pageLinks->insert(f);
+    if( allLinks.find(f) == allLinks.end()
+        && currs.find(f) == currs.end() ) {
+        /* we have never seen that vertex before (i.e. white)
+           so let's add it to the list of successors to process. */
+#if 0
+        std::cerr << ", add " << f;
+#endif
+        nexts.insert(f);
+    }
+}
+
+
 template<typename charT, typename traitsT>
 bool basicLinkLight<charT,traitsT>::decorate( const url& u )
 {
@@ -229,11 +389,69 @@ bool basicLinkLight<charT,traitsT>::decorate( const url& u )
 }
 
 
+template<typename charT, typename traitsT>
+void basicLinkLight<charT,traitsT>::detach() {
+    if( super::next != NULL ) {
+        super::sync();
+        flush();
+    }
+    super::detach();
+}
+
+
+template<typename charT, typename traitsT>
+void basicLinkLight<charT,traitsT>::boundary() {
+    /* Markup from the previous decorator always ends outside
+       of a tag. */
+    flush();
+    state = linkStartState;
+    super::tokenizer.reset();
+    super::boundary();
+}
+
+
+template<typename charT, typename traitsT>
+void basicLinkLight<charT,traitsT>::flush() {
+    if( !pending.empty() ) {
+        std::string text;
+        text.swap(pending);
+        categorize(pendingToken,text.data(),0,text.size());
+    }
+}
+
+
 template<typename charT, typename traitsT>
 void basicLinkLight<charT,traitsT>::token( xmlToken token,
     const char *line,
     int first, int last,
     bool fragment )
+{
+    if( !pending.empty() ) {
+        if( token == pendingToken ) {
+            pending.append(&line[first],last - first);
+            if( !fragment ) flush();
+            return;
+        }
+        /* The tokenizer does not always emit an empty last part. */
+        flush();
+    }
+    if( fragment && (token == xmlName || token == xmlAttValue) ) {
+        /* A double-quote terminates both forms of attribute values. */
+        if( token != xmlAttValue || last - first < 2
+            || line[last - 1] != '"' ) {
+            pendingToken = token;
+            pending.assign(&line[first],last - first);
+            return;
+        }
+    }
+    categorize(token,line,first,last);
+}
+
+
+template<typename charT, typename traitsT>
+void basicLinkLight<charT,traitsT>::categorize( xmlToken token,
+    const char *line,
+    int first, int last )
 {
     bool needPut = true;
 
@@ -251,7 +469,7 @@ void basicLinkLight<charT,traitsT>::token( xmlToken token,
         break;
     case xmlAttValue:
         /* Categorize link */
-        if( state == linkWaitAttState ) {
+        if( state == linkWaitAttState && last - first >= 2 ) {
             std::string name(&line[first + 1],last - first - 2);
             needPut = decorate(url(name));
         }
@@ -322,17 +540,14 @@ void basicCppLight<charT,traitsT>::newline(const char *line,
     int first, int last )
 {
     if( preprocessing ) {
-        std::string endSpan("</span>");
-        super::nextBuf->sputn(endSpan.c_str(),endSpan.size());
+        super::markup("</span>",7);
     }
     super::nextBuf->sputc('\n');
     if( preprocessing & virtualLineBreak ) {
         std::string staSpan("<span class=\"");
-        super::nextBuf->sputn(staSpan.c_str(),staSpan.size());
-        super::nextBuf->sputn(cppTokenTitles[cppPreprocessing],
-            strlen(cppTokenTitles[cppPreprocessing]));
-        super::nextBuf->sputc('"');
-        super::nextBuf->sputc('>');
+        staSpan += cppTokenTitles[cppPreprocessing];
+        staSpan += "\">";
+        super::markup(staSpan.c_str(),staSpan.size());
     } else {
         preprocessing = false;
     }
@@ -345,36 +560,33 @@ void basicCppLight<charT,traitsT>::token( cppToken token,
     int first, int last,
     bool fragment ) {
 
-    std::string staSpan("<span class=\"");
-    std::string endSpan("</span>");
     if( !preprocessing ) {
-        super::nextBuf->sputn(staSpan.c_str(),staSpan.size());
-        super::nextBuf->sputn(cppTokenTitles[token],
-            strlen(cppTokenTitles[token]));
-        super::nextBuf->sputc('"');
-        super::nextBuf->sputc('>');
+        std::string staSpan("<span class=\"");
+        staSpan += cppTokenTitles[token];
+        staSpan += "\">";
+        super::markup(staSpan.c_str(),staSpan.size());
         if( token == cppPreprocessing ) preprocessing = true;
     }
     if( token != cppComment ) {
         /* Special caracters are not replaced within comments
            such that they can be used to mark up text as html. */
-        for( ; first != last; ++first ) {
-            switch( line[first] ) {
-            case '<':
-                super::nextBuf->sputn("&lt;",4);
-                break;
-            case '>':
-                super::nextBuf->sputn("&gt;",4);
-                break;
-            default:
-                super::nextBuf->sputc(line[first]);
-            }
+        static const char stops[] = { '<', '>' };
+        const char *p = &line[first];
+        const char *end = &line[last];
+        while( p != end ) {
+            const char *q = scanFirstOf(p,end,stops,sizeof(stops));
+            if( q != p ) super::markup(p,q - p);
+            if( q == end ) break;
+            super::markup(*q == '<' ? "&lt;" : "&gt;",4);
+            p = q + 1;
         }
     } else {
+        /* Comments are the only text the decorators that follow
+           in a fused chain can change. */
         super::nextBuf->sputn(&line[first],last - first);
     }
     if( !preprocessing ) {
-        super::nextBuf->sputn(endSpan.c_str(),endSpan.size());
+        super::markup("</span>",7);
     }
     virtualLineBreak = fragment;
 }
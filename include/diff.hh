@@ -0,0 +1,124 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef guarddiff
+#define guarddiff
+
+#include <vector>
+#include "slice.hh"
+
+/** Line-by-line differences between two texts.
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace tero {
+
+/** Callback interface of textDiff.
+
+    Hunks are reported in text order and alternate between runs
+    of lines common to both texts and runs of lines that differ.
+*/
+class diffListener {
+public:
+    virtual ~diffListener() {}
+
+    /** *left* holds *leftLines* lines of the left text and *right* 
+        holds *rightLines* lines of the right text. When *changed* 
+        is false, both runs are made of the same lines. When *changed*
+        is true, one of the runs might be empty. The last line 
+        of a text might not end with a '\\n'. */
+    virtual void hunk( const slice<const char>& left, size_t leftLines,
+        const slice<const char>& right, size_t rightLines, 
+        bool changed ) = 0;
+};
+
+
+/** Aligns the lines of two texts in memory.
+
+    Lines that appear exactly once in both texts anchor the alignment
+    (patience diff). The runs between anchors that share no such lines
+    are aligned with Myers' O(ND) algorithm in linear space. Runs that
+    would take too long to align are reported as changed as a whole.
+*/
+class textDiff {
+public:
+    typedef std::vector<slice<const char> > lineSet;
+
+    /** Index of a line that has no counterpart in the other text. */
+    static const size_t npos;
+
+protected:
+    diffListener *listener;
+
+    lineSet leftLines;
+    lineSet rightLines;
+
+    /* Lines with the same text share the same identifier. */
+    std::vector<size_t> leftIds;
+    std::vector<size_t> rightIds;
+    size_t nbIds;
+
+    /* Index of the matching line in the other text, or npos. */
+    std::vector<size_t> leftMatch;
+    std::vector<size_t> rightMatch;
+
+    /* Scratch space reused between runs. */
+    std::vector<int> forward;
+    std::vector<int> backward;
+    std::vector<size_t> leftCount;
+    std::vector<size_t> rightCount;
+    std::vector<size_t> rightPos;
+
+    void intern();
+
+    void match( size_t left, size_t right ) {
+        leftMatch[left] = right;
+        rightMatch[right] = left;
+    }
+
+    void align( size_t leftFirst, size_t leftLast,
+        size_t rightFirst, size_t rightLast );
+
+    void bisect( size_t leftFirst, size_t leftLast,
+        size_t rightFirst, size_t rightLast );
+
+    void report();
+
+public:
+    textDiff() : listener(NULL), nbIds(0) {}
+
+    explicit textDiff( diffListener& l ) : listener(&l), nbIds(0) {}
+
+    void attach( diffListener& l ) { listener = &l; }
+
+    /** Reports the differences between *left* and *right* 
+        to the listener. */
+    void diff( const slice<char>& left, const slice<char>& right );
+};
+
+}
+
+#endif
@@ -136,6 +136,11 @@ void docbookFetch( session& s, const url& name );
  */
 void docbookMeta( session& s, const url& name );
 
+/** Fills *p* with the title and presentation of a docbook file
+    out of a single parse of the document.
+*/
+void docbookPost( session& s, post& p, const url& name );
+
 }
 
 #endif
@@ -26,9 +26,13 @@
 #ifndef guarddocument
 #define guarddocument
 
+#include <list>
+#include <map>
+#include <set>
 #include "session.hh"
 #include "markup.hh"
 #include "revsys.hh"
+#include "regexset.hh"
 
 /**
    Basic functions to display the content of a "document".
@@ -65,6 +69,17 @@ enum pipeFetchType {
 };
 
 
+/** When the dispatcher has found a matching pattern (and associated
+   callback) for a pathname, it will check if the output of the callback
+   can be replayed from the fragment cache instead of calling
+   the fetch method again.
+*/
+enum cacheFetchType {
+    noCache       = 0x0,
+    whenCache     = 0x10
+};
+
+
 /** Prototype for document callbacks
 
    When the dispatcher has found a matching pattern (and associated
@@ -87,6 +102,15 @@ typedef
 void (*textFetchFunc)( session& s, const slice<char>& text,
     const url& name );
 
+class post;
+
+/** Prototype for callbacks that fill the fields of a post out of
+    a document in a single pass, instead of printing the title, author,
+    date and content through separate callbacks (see feedContent).
+*/
+typedef
+void (*postFetchFunc)( session& s, post& p, const url& name );
+
 
 /** An entry in the dispatch table.
  */
@@ -97,6 +121,7 @@ struct fetchEntry {
     nameFetchFunc nameFetch;
     streamFetchFunc streamFetch;
     textFetchFunc textFetch;
+    postFetchFunc postFetch;
 };
 
 
@@ -107,6 +132,10 @@ bool operator<( const fetchEntry& left, const fetchEntry& right ) {
 
 
 extern urlVariable nextpage;
+extern intVariable jobs;
+extern intVariable checkThreads;
+extern intVariable fragmentCacheSize;
+extern intVariable highlightHighWater;
 
 /** Add session variables related to generic documents.
  */
@@ -114,6 +143,112 @@ void docAddSessionVars( boost::program_options::options_description& opts,
     boost::program_options::options_description& visible );
 
 
+/** Output of the callbacks flagged *whenCache*.
+
+    A fragment is replayed as long as the stamps (see revisionsys::stamp)
+    of the files, directories and repositories read while it was generated
+    did not change. Least recently used fragments are evicted when
+    the size of the cache goes over *maxSize* bytes.
+*/
+class fragmentCache {
+public:
+    typedef std::map<boost::filesystem::path,std::string> stampMap;
+
+protected:
+    typedef std::list<std::string> lruList;
+
+    struct fragment {
+        std::string text;
+        stampMap deps;
+        lruList::iterator used;
+    };
+
+    typedef std::map<std::string,fragment> fragmentMap;
+
+    fragmentMap fragments;
+
+    /** keys of fragments, most recently used first. */
+    lruList lru;
+
+    size_t totalSize;
+
+    void erase( fragmentMap::iterator f );
+
+public:
+    size_t maxSize;
+
+    unsigned long hits;
+
+    unsigned long misses;
+
+    explicit fragmentCache( size_t m = 4 * 1024 * 1024 )
+        : totalSize(0), maxSize(m), hits(0), misses(0) {}
+
+    /** returns the output cached for *key* or NULL if none is cached
+        or it is out-of-date. On a hit, the dependencies of the fragment
+        are recorded as dependencies of the page being generated. */
+    const std::string* find( session& s, const std::string& key );
+
+    void insert( const std::string& key, const std::string& text,
+        const session::dependencySet& deps );
+};
+
+
+extern pathVariable highlightCacheDir;
+extern intVariable highlightCacheSize;
+
+/** Decorated source files stored on disk.
+
+    An entry is keyed by the content of a source file (the blob id
+    in a git repository, see revisionsys::findRevContentId), its location,
+    the decorators applied to it and the site it links into. Along with
+    the decorated text, an entry holds the links to local files found
+    while decorating it, such that a replay records them as well.
+
+    Entries for older contents are never looked up again, so the least
+    recently replayed entries are removed once the directory grows past
+    *highlightCacheSize*.
+*/
+class highlightCache {
+public:
+    typedef std::set<url> linkSet;
+
+protected:
+    /** directory the entries are stored into. Empty when
+        the cache is disabled. */
+    boost::filesystem::path dir;
+
+    /** maximum number of bytes stored in *dir*, or zero
+        when the cache is not bounded. */
+    boost::uintmax_t maxSize;
+
+    boost::filesystem::path entryPath( const std::string& key ) const;
+
+    /** Removes the least recently used entries when the total size
+        of *dir* exceeds *maxSize*. Stores only call it once their
+        running count of bytes written crosses *maxSize*. */
+    void prune() const;
+
+public:
+    explicit highlightCache( session& s );
+
+    bool enabled() const { return !dir.empty(); }
+
+    /** returns the key for *pathname* decorated by *chainId* or
+        an empty string when the content of *pathname* cannot be
+        identified. */
+    std::string key( session& s, const boost::filesystem::path& pathname,
+        const char *chainId ) const;
+
+    /** Writes the decorated text cached for *key* to s.out() and
+        records its links. Returns false when nothing is cached. */
+    bool replay( session& s, const std::string& key ) const;
+
+    void store( const std::string& key, const std::string& text,
+        const linkSet& links ) const;
+};
+
+
 /* Pick the appropriate presentation entry (callback) based on regular
    expressions applied to a document name.
  */
@@ -122,10 +257,19 @@ protected:
     fetchEntry* entries;
     size_t nbEntries;
 
+    /** The patterns associated to a name compiled into a single
+        automaton, indexed by the first entry for that name. */
+    std::vector<regexSet*> matchers;
+
     static dispatchDoc *singleton;
 
+    fragmentCache fragments;
+
     void fetch( session& s, const fetchEntry *doc, const url& value );
 
+    /** Invoke the fetch method of *doc*, bypassing the fragment cache. */
+    void invoke( session& s, const fetchEntry *doc, const url& value );
+
 public:
 
     /** Initialize the dispatcher with a set of (name,pattern,callback)
@@ -137,6 +281,8 @@ public:
     */
     dispatchDoc( fetchEntry* entries, size_t nbEntries );
 
+    ~dispatchDoc();
+
     /** returns the singleton instance
      */
     static dispatchDoc *instance() {
@@ -158,6 +304,10 @@ public:
     const fetchEntry*
     select( const std::string& name, const std::string& value ) const;
 
+    /** Fragments replayed instead of calling fetch methods again. */
+    const fragmentCache& cache() const { return fragments; }
+
+    fragmentCache& cache() { return fragments; }
 };
 
 
@@ -220,6 +370,11 @@ void metaLastTime( session& s, const boost::filesystem::path& pathname );
  */
 void metaFileOwner( session& s, const boost::filesystem::path& pathname );
 
+/** Assign the owner of *pathname* to the author and authorEmail session
+    variables and returns the owner name.
+ */
+std::string fileOwner( session& s, const boost::filesystem::path& pathname );
+
 
 /** Prints *pathname* on the session output.
  */
@@ -285,24 +440,33 @@ protected:
     decorator *leftDec;
     decorator *rightDec;
 
+    /** Identifies the decorators in a highlightCache key. Texts
+        without an identifier are not cached. */
+    const char *chainId;
+
+    /** Writes the lines of *in* through the left decorator. */
+    void decorate( session& s, std::istream& in );
+
 public:
-    text() : leftDec(NULL), rightDec(NULL) {}
+    text() : leftDec(NULL), rightDec(NULL), chainId(NULL) {}
 
-    text( decorator& l,  decorator& r )
-        : leftDec(&l), rightDec(&r) {}
+    text( decorator& l,  decorator& r, const char *id = NULL )
+        : leftDec(&l), rightDec(&r), chainId(id) {}
 
     /** \brief show difference between two texts side by side
 
-        \param  doc              document to do syntax coloring
-        \param  input            showing on the left pane
-        \param  diff             difference between left and right pane
-        \param  inputIsLeftSide  true when input stream is left side
+        The lines of *left* and *right* are aligned (see textDiff)
+        and written as the rows of a two columns table through
+        the left and right decorators respectively.
     */
     void showSideBySide( session& s,
-        std::istream& input, std::istream& diff,
-        bool inputIsLeftSide= true ) const;
+        const slice<char>& left, const slice<char>& right ) const;
 
     void fetch( session& s, std::istream& in );
+
+    /** Same as fetch( session&, std::istream& ) except the decorated
+        text of *name* is replayed from the highlightCache when present. */
+    void fetch( session& s, std::istream& in, const url& name );
 };
 
 /** Skip over the meta information
@@ -0,0 +1,133 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef guardfastcgi
+#define guardfastcgi
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+/** Minimal FastCGI responder
+
+    The web server (or a process manager like spawn-fcgi) passes
+    a listening socket as file descriptor 0 and forwards requests
+    through FastCGI records on the connections accepted on that socket.
+    (See http://www.fastcgi.com/devkit/doc/fcgi-spec.html for documentation.)
+
+    Requests are served one at a time, on a single connection at a time.
+    The CGI parameters of a request are exported as environment variables
+    such that code written for a one-shot CGI executable works unmodified.
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace tero {
+
+class fastcgi;
+
+/** Wraps everything written to it into FCGI_STDOUT records.
+ */
+class fastcgiStreambuf : public std::streambuf {
+protected:
+    enum { bufferSize = 32768 };
+
+    fastcgi *conn;
+    char buffer[bufferSize];
+
+    virtual int_type overflow( int_type c );
+
+    virtual int sync();
+
+public:
+    explicit fastcgiStreambuf( fastcgi& c );
+};
+
+
+class fastcgi {
+protected:
+    friend class fastcgiStreambuf;
+
+    /** socket the web server passed to the process */
+    int listenfd;
+
+    /** connection the current request was received on */
+    int connfd;
+
+    /** request identifier, as assigned by the web server */
+    unsigned int requestId;
+
+    /** close the connection once the request has been answered */
+    bool closeConn;
+
+    /** names of the environment variables set for the current request. */
+    std::vector<std::string> envnames;
+
+    std::stringstream body;
+
+    fastcgiStreambuf obuf;
+
+    std::ostream ostr;
+
+    bool readRecord( unsigned char& type, unsigned int& reqId,
+        std::string& content );
+
+    void writeRecord( unsigned char type, unsigned int reqId,
+        const char *content, size_t length );
+
+    void params( const std::string& content );
+
+    void values( const std::string& content );
+
+public:
+    explicit fastcgi( int fd = 0 );
+
+    ~fastcgi();
+
+    /** Waits for the next request. The request parameters are set
+        in the process environment, the request content is available
+        through *in()*. Returns false when the web server closed
+        the listening socket.
+    */
+    bool accept();
+
+    /** Content sent along the request (i.e. POST data).
+     */
+    std::istream& in() { return body; }
+
+    /** Response to the request.
+     */
+    std::ostream& out() { return ostr; }
+
+    /** Flushes the response and signals the web server
+        the request is complete.
+    */
+    void finish( int appStatus );
+};
+
+}
+
+#endif
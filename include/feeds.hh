@@ -50,18 +50,38 @@ namespace tero {
 
 /** On flush (i.e. provide), the feedOrdered retained filter will sort
     its posts using the *cmp* operator and pass it to the next filter
-    down in sorted order. */
+    down in sorted order.
+
+    When only the first posts in sorted order are of interest
+    (see feedPage), the filter retains at most that many posts
+    in a heap as they come through *filters* and discards the others. */
 template<typename cmp>
 class feedOrdered : public retainedFilter {
 public:
     typedef retainedFilter super;
     typedef std::iterator_traits<iterator>::difference_type difference_type;
 
+protected:
+    /** maximum number of posts retained, or zero when all posts
+        are retained. */
+    size_t retainMax;
+
+    /** true when *posts* is in sorted order, false when it is
+        a heap (or unsorted when all posts are retained). Feeds
+        can be flushed more than once. */
+    bool sorted;
+
     virtual void provide();
 
 public:
-    feedOrdered() {}
-    explicit feedOrdered( postFilter *n ) : super(n) {}    
+    feedOrdered() : retainMax(0), sorted(false) {}
+    explicit feedOrdered( postFilter *n )
+        : super(n), retainMax(0), sorted(false) {}
+
+    /** Only retains the first *n* posts in sorted order. */
+    void retainFirst( size_t n ) { retainMax = n; }
+
+    virtual void filters( const post& p );
 };
 
 
@@ -129,10 +149,15 @@ public:
 	: super(b), base(0), length(maxLength) {}
 
     feedPage( const feedBase& b, size_t pageLength ) 
-	: super(b), base(0), length(pageLength) {}
+	: super(b), base(0), length(pageLength) {
+        super::retainFirst(pageLength);
+    }
 
     feedPage( const feedBase& b, size_t pageLength, size_t pageNum ) 
-	: super(b), base(pageNum * pageLength), length(pageLength) {}
+	: super(b), base(pageNum * pageLength), length(pageLength) {
+        /* Posts sorted after the page are never shown. */
+        super::retainFirst((pageNum + 1) * pageLength);
+    }
 };
 
 
@@ -203,6 +228,58 @@ template<typename defaultWriter, const char* filePat>
 void feedContent( session& s, const boost::filesystem::path& pathname );
 
 
+/** Redirects the session output into a string for the lifetime
+    of the object, such that the text printed by callbacks can be
+    stored into a post.
+*/
+class captureOutput {
+protected:
+    session *context;
+    std::stringstream text;
+    std::ostream& prevOut;
+
+public:
+    explicit captureOutput( session& s )
+        : context(&s), prevOut(s.out(text)) {}
+
+    ~captureOutput() { context->out(prevOut); }
+
+    std::string str() const { return text.str(); }
+};
+
+
+/** Stores in *text* what the *varname* callback prints for *name*.
+    Returns false when there is no such callback.
+*/
+bool fetchText( session& s, std::string& text,
+    const std::string& varname, const url& name );
+
+/** Returns the title of *name* as metaFetch<title> prints it.
+*/
+std::string fileTitle( session& s, const url& name );
+
+/** Returns the owner of *pathname* as the author of a post.
+*/
+contrib::pointer_type fileAuthor( session& s,
+    const boost::filesystem::path& pathname );
+
+/** Returns the last modification time of *pathname*.
+*/
+boost::posix_time::ptime fileTime( const boost::filesystem::path& pathname );
+
+/** Sets the content of *p* to the presentation of *name* through
+    its "content" callback, or to the url of *name* when there is none.
+*/
+void postContent( session& s, post& p, const url& name );
+
+/** Fills *p* with the title, owner, last modification time
+    and presentation of the file *name*.
+
+    This is the default "post" callback used by feedContent.
+*/
+void filePost( session& s, post& p, const url& name );
+
+
 /** Feed of summaries for files in a directory.
     The summary is based on the first N lines of the file
     or the filename when there are no assiated presentation.
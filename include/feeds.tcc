@@ -30,12 +30,43 @@
 
 namespace tero {
 
+template<typename cmp>
+void feedOrdered<cmp>::filters( const post& p )
+{
+    cmp c;
+    if( retainMax == 0 ) {
+        sorted = false;
+        super::filters(p);
+        return;
+    }
+    /* *posts* is a heap whose front is the last post in sorted order. */
+    if( sorted ) {
+        std::make_heap(posts.begin(),posts.end(),c);
+        sorted = false;
+    }
+    if( posts.size() < retainMax ) {
+        posts.push_back(p);
+        std::push_heap(posts.begin(),posts.end(),c);
+    } else if( c(p,posts.front()) ) {
+        std::pop_heap(posts.begin(),posts.end(),c);
+        posts.back() = p;
+        std::push_heap(posts.begin(),posts.end(),c);
+    }
+}
+
+
 template<typename cmp>
 void feedOrdered<cmp>::provide()
 {
     cmp c;
     super::provide();
-    std::sort(first,last,c);
+    if( sorted ) return;
+    if( retainMax > 0 ) {
+        std::sort_heap(first,last,c);
+    } else {
+        std::sort(first,last,c);
+    }
+    sorted = true;
 }
 
 
@@ -90,6 +121,7 @@ void feedAggregate( session& s,
         /* We check and handle repositories in the previous clause
            so iterating the filesystem directories is the correct thing
            to do here. */
+        s.depends(dirname);
         for( directory_iterator entry = directory_iterator(dirname);
              entry != directory_iterator(); ++entry ) {
             /* \todo include/exclude filtering should surely be done here. */
@@ -131,6 +163,7 @@ void feedContent( session& s, const boost::filesystem::path& pathname ) {
     }
 
     if( !base.empty() ) {
+		s.depends(base);
 		for( directory_iterator entry = directory_iterator(base);
 			 entry != directory_iterator(); ++entry ) {
 			boost::smatch m;
@@ -151,40 +184,36 @@ void feedContent( session& s, const boost::filesystem::path& pathname ) {
 					   and non blog files are generated as posts. */
 					dispatchDoc::instance()->fetch(s,"content",link);
 				} else {
-					std::stringstream content;
-					std::ostream& prevDisp = s.out(content);
 					post p;
-					content.str("");
-					if( !dispatchDoc::instance()->fetch(s,"title",link)) {
-						content << s.asUrl(filename);
-					}
-					p.title = content.str();
-					content.str("");
-					if( !dispatchDoc::instance()->fetch(s,"author",link)) {
-						metaFileOwner(s,filename);
-					}
-					p.author = contrib::find(authorEmail.value(s),
-                        content.str());
-					content.str("");
-					if( !dispatchDoc::instance()->fetch(s,"date",link)) {
-						metaLastTime(s,filename);
-					}
-					try {
-						p.time = parse_datetime(content.str());
-					} catch( std::exception& e ) {
-						std::cerr << "error: unable to reconstruct time from \"" << content.str() << '"' << std::endl;
+					const fetchEntry* pe = dispatchDoc::instance()->select(
+						"post",filename.string());
+					if( pe != NULL && pe->postFetch != NULL ) {
+						/* The document is loaded once to fill all fields
+						   of the post. */
+						pe->postFetch(s,p,link);
+					} else {
+						/* Documents without a post callback (ex: build logs)
+						   are assembled from the text each callback prints. */
+						std::string text;
+						if( !fetchText(s,text,"title",link) ) {
+							text = s.asUrl(filename).string();
+						}
+						p.title = text;
+						if( fetchText(s,text,"author",link) ) {
+							p.author = contrib::find(authorEmail.value(s),text);
+						} else {
+							p.author = fileAuthor(s,filename);
+						}
+						p.time = fileTime(filename);
+						if( fetchText(s,text,"date",link) ) {
+							try {
+								p.time = parse_datetime(text);
+							} catch( std::exception& e ) {
+								std::cerr << "error: unable to reconstruct time from \"" << text << '"' << std::endl;
+							}
+						}
+						postContent(s,p,link);
 					}
-					content.str("");
-					/* \todo Be careful here, if there are no *.blog pattern
-					   but there is a /blog/.* pattern in the dispatch table,
-					   this will create an infinite loop that only stops when
-					   the system runs out of file descriptor. I am not sure
-					   how to avoid or pop an error for this case yet. */
-					if( !dispatchDoc::instance()->fetch(s,"content",link)) {
-						content << s.asUrl(filename);
-					}    
-					p.content = content.str();
-					s.out(prevDisp);
 					s.feeds->filters(p);
 				}
 			}
@@ -0,0 +1,154 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef guardgitobjects
+#define guardgitobjects
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/filesystem/path.hpp>
+
+/** Read objects out of a git repository without spawning git.
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace tero {
+
+/** Object database of a git repository.
+
+    Objects are looked up in the loose objects directory, then
+    in the packfiles through their .idx index. Deltified objects
+    in packfiles are resolved in-process.
+
+    All methods return false (or *none*) when an object cannot be found
+    or uses a feature that is not supported (alternates, abbreviated
+    commit ids, revision expressions, etc.) such that the caller can
+    fall back to running git.
+*/
+class gitObjects {
+public:
+    enum objectType {
+        none = 0,
+        commitObj = 1,
+        treeObj = 2,
+        blobObj = 3,
+        tagObj = 4
+    };
+
+    typedef std::vector<char> buffer;
+
+    /** Binary (20 bytes) identifier of an object. */
+    typedef std::string objectId;
+
+    struct treeEntry {
+        unsigned int mode;
+        std::string name;
+        objectId id;
+
+        bool isTree() const { return (mode & 0170000) == 0040000; }
+    };
+
+    typedef std::vector<treeEntry> treeEntries;
+
+protected:
+    enum {
+        ofsDelta = 6,
+        refDelta = 7,
+        maxDeltaDepth = 1024
+    };
+
+    struct packfile {
+        boost::filesystem::path pathname;
+        int fd;
+        int version;
+        unsigned int count;
+        buffer idx;
+
+        packfile() : fd(-1), version(0), count(0) {}
+    };
+
+    typedef std::map<boost::filesystem::path,packfile*> packSet;
+
+    /** metadir of the repository (i.e. .git or the bare repository) */
+    boost::filesystem::path gitdir;
+
+    packSet packs;
+
+    void clear();
+
+    /** load the indices of packfiles not seen yet. */
+    void scanPacks();
+
+    bool find( const packfile& pack, const objectId& id,
+        unsigned long long& offset ) const;
+
+    objectType readLoose( const objectId& id, buffer& data );
+
+    objectType readPacked( packfile& pack, unsigned long long offset,
+        buffer& data, int depth );
+
+    objectType readObject( const objectId& id, buffer& data, int depth );
+
+    bool resolveRef( const std::string& ref, objectId& id, int depth );
+
+public:
+    gitObjects() {}
+
+    ~gitObjects() { clear(); }
+
+    /** Use the repository whose metadir is *gitdir*. The packfile indices
+        loaded so far are kept when *gitdir* does not change. */
+    void open( const boost::filesystem::path& gitdir );
+
+    /** Resolves a revision (full commit id, HEAD or a ref name)
+        into the id of an object. */
+    bool resolve( const std::string& rev, objectId& id );
+
+    /** Reads the object *id* into *data*. */
+    objectType read( const objectId& id, buffer& data );
+
+    /** Finds the id of the object at *pathname* in the tree of *rev*
+        without reading the object itself. */
+    objectType locate( const std::string& rev,
+        const boost::filesystem::path& pathname, objectId& id );
+
+    /** Reads the object at *pathname* in the tree of *rev* into *data*.
+        An empty *pathname* stands for the root tree. */
+    objectType lookup( const std::string& rev,
+        const boost::filesystem::path& pathname, buffer& data );
+
+    /** Splits the content of a tree object into its entries. */
+    static void parseTree( const buffer& data, treeEntries& entries );
+
+    static std::string hex( const objectId& id );
+
+    static bool unhex( const std::string& text, objectId& id );
+};
+
+}
+
+#endif
@@ -45,6 +45,11 @@ void junitDate( session& s, const url& name );
 
 void junitContent( session& s, const slice<char>& text, const url& name );
 
+/** Fills *p* with the timestamp and summary of a JUnit file
+    out of a single parse of the file.
+ */
+void junitPost( session& s, post& p, const url& name );
+
 void logviewFetch( session& s, const url& name );
 
 /** Summaries of build logs to be included in a feed.
@@ -108,6 +108,9 @@ public:
         int first, int last, bool fragment );
 
     const post& unserialized() const { return constructed; }
+
+    /** Moves the post reconstructed so far into *p*. */
+    void unserialized( post& p ) { p.swap(constructed); }
 };
 
 
@@ -71,11 +71,81 @@ public:
 public:
     void normalize();
 
+    /** Returns the contributor with e-mail address *email*
+        and display name *name*.
+
+        Contributors are interned by address only (compared without
+        case or surrounding whitespaces) such that all posts by the same
+        author share a single instance. *name* is recorded when the
+        contributor did not have one yet. When it differs from the name
+        already recorded, a copy carrying *name* is returned for the
+        caller's post alone. The instance returned is shared and must
+        not be modified; copy it first to set profile fields for a single
+        post. Without an address, a new instance is returned. */
     static pointer_type find( const std::string& email,
         const std::string& name = "" );
+
+    /** Releases all interned contributors. Instances still referenced
+        by posts stay valid. */
+    static void clear();
 };
 
 
+/** Immutable text shared between copies of a post.
+
+    Posts are copied as they flow down a chain of filters (retained
+    by ordered feeds, forwarded once per tag, etc.). Copying the text
+    only adds a reference to the same body. Assigning new text
+    to a post never modifies the text seen by other copies.
+*/
+class sharedText {
+protected:
+    typedef std::tr1::shared_ptr<const std::string> pointer_type;
+
+    pointer_type body;
+
+public:
+    sharedText() {}
+
+    sharedText( const std::string& text )
+        : body(new std::string(text)) {}
+
+    sharedText( const char *first, const char *last )
+        : body(new std::string(first,last)) {}
+
+    sharedText& operator=( const std::string& text ) {
+        body.reset(new std::string(text));
+        return *this;
+    }
+
+    /** Takes ownership of the characters in *text*, leaving it empty. */
+    void adopt( std::string& text ) {
+        std::string *adopted = new std::string();
+        adopted->swap(text);
+        body.reset(adopted);
+    }
+
+    const std::string& str() const {
+        static const std::string none;
+        return body ? *body : none;
+    }
+
+    operator const std::string&() const { return str(); }
+
+    bool empty() const { return !body || body->empty(); }
+
+    size_t size() const { return body ? body->size() : 0; }
+
+    void clear() { body.reset(); }
+
+    void swap( sharedText& other ) { body.swap(other.body); }
+};
+
+inline std::ostream& operator<<( std::ostream& ostr, const sharedText& v ) {
+    return ostr << v.str();
+}
+
+
 /** At the heart of every post there is a required date, author and
     full-length textual content.
 
@@ -97,9 +167,9 @@ public:
      */
     boost::posix_time::ptime time;
 
-    /** The text content of the post.
+    /** The text content of the post, shared between copies of the post.
      */
-    std::string content;
+    sharedText content;
 
     // optional
 
@@ -156,21 +226,9 @@ public:
      */
     bool valid() const;
 
-#if 1
-    post() {}
-
-    post( const post& p ) :
-	author(p.author),
-	time(p.time),
-	content(p.content),
-	link(p.link),
-	title(p.title),
-	guid(p.guid),
-	filename(p.filename),
-	score(p.score),
-	tag(p.tag),
-	moreHeaders(p.moreHeaders) {}
-#endif
+    /** Exchanges the fields of two posts without copying them.
+     */
+    void swap( post& p );
 };
 
 
@@ -91,6 +91,12 @@ void projCreateFetch( session& s, const url& name );
 */
 void projindexFetch( session& s, const slice<char>& text, const url& name );
 
+/** Fills *p* with the project name and the project view of an index
+    file. The title is derived from the path so the index file is only
+    loaded to present it.
+*/
+void projectPost( session& s, post& p, const url& name );
+
 
 class projfiles : public dirwalker {
 protected:
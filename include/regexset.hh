@@ -0,0 +1,155 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#ifndef guardregexset
+#define guardregexset
+
+#include <bitset>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/regex.hpp>
+
+/** Match a string against an ordered set of regular expressions
+    in a single linear scan.
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace tero {
+
+/** An ordered set of regular expressions compiled into a single automaton.
+
+    match() returns the index of the first expression in the set that
+    matches the whole input string, as regex_match() called on each
+    expression in order would do, but the input is scanned only once.
+
+    The automaton is a DFA built lazily out of a Thompson NFA. Only
+    the subset of the perl syntax that does not require backtracking
+    (literals, escapes, character classes, groups, alternations
+    and quantifiers) is supported. When one of the expressions uses
+    anything else (back references, look-aheads, etc.), compiled()
+    returns false and the caller should fall back to boost::regex.
+*/
+class regexSet {
+protected:
+    typedef std::bitset<256> charSet;
+
+    /** Parse tree of a regular expression. */
+    struct node {
+        enum kindType {
+            empty,
+            chars,
+            concat,
+            alternate,
+            repeat
+        };
+
+        kindType kind;
+        charSet accepts;
+        std::vector<node> children;
+        int minRepeat;
+        int maxRepeat;
+
+        explicit node( kindType k = empty )
+            : kind(k), minRepeat(1), maxRepeat(1) {}
+    };
+
+    /** A state in the NFA. A state either consumes a character
+        in *accepts* and moves to *outs[0]* or moves through
+        epsilon transitions to all *outs*. A state with a positive
+        *pattern* index is an accepting state for that pattern. */
+    struct nfaState {
+        bool epsilon;
+        int pattern;
+        charSet accepts;
+        std::vector<int> outs;
+
+        nfaState() : epsilon(true), pattern(-1) {}
+    };
+
+    /** A state in the DFA. Transitions are stored in *dfaNext*. */
+    struct dfaState {
+        std::vector<int> nfaStates;
+        int pattern;
+    };
+
+    typedef std::map<std::vector<int>,int> dfaIndex;
+
+    enum {
+        unknownState = -1,
+        deadState = -2,
+        maxDfaStates = 1024
+    };
+
+    bool valid;
+
+    int nbPatterns;
+
+    std::vector<nfaState> nfa;
+
+    int nfaStart;
+
+    mutable std::vector<dfaState> dfa;
+
+    /** transition table, 256 entries per DFA state. */
+    mutable std::vector<int> dfaNext;
+
+    mutable dfaIndex dfaIds;
+
+    class parser;
+
+    int compile( const node& n, int next );
+
+    void closure( std::vector<int>& states, int s,
+        std::vector<bool>& visited ) const;
+
+    int state( std::vector<int>& states ) const;
+
+    void start() const;
+
+    int transition( int from, unsigned char c ) const;
+
+public:
+    regexSet();
+
+    /** Adds *pat* at the end of the ordered set. Returns false
+        if the expression cannot be compiled into the automaton.
+    */
+    bool add( const boost::regex& pat );
+
+    /** returns true if all expressions added so far could be compiled.
+     */
+    bool compiled() const { return valid; }
+
+    /** returns the index of the first expression that matches *value*
+        or -1 if none matches.
+    */
+    int match( const std::string& value ) const;
+};
+
+}
+
+#endif
@@ -73,11 +73,6 @@ public:
     virtual boost::filesystem::path
     relative( const boost::filesystem::path& p ) const;
 
-    virtual void diff( std::ostream& ostr,
-        const std::string& leftCommit,
-        const std::string& rightCommit,
-        const boost::filesystem::path& pathname ) = 0;
-
     virtual void history( std::ostream& ostr,
         const session& s,
         const boost::filesystem::path& pathname,
@@ -97,12 +92,22 @@ public:
         const std::string& commit,
         decorator *dec = NULL ) = 0;
 
-    virtual slice<char> loadtext( const boost::filesystem::path& pathname,
+    virtual sharedSlice<char> loadtext(
+        const boost::filesystem::path& pathname,
         const std::string& commit ) = 0;
 
     virtual std::streambuf* openfile( const boost::filesystem::path& pathname,
         const std::string& commit ) = 0;
 
+    /** returns a string that changes whenever the content of *pathname*
+        at *commit* changes (the blob id in a git repository) or 
+        an empty string when it cannot be derived without reading 
+        the content. */
+    virtual std::string contentId( const boost::filesystem::path& pathname,
+        const std::string& commit ) {
+        return std::string();
+    }
+
     /** returns a revision system when dirname can be reliably determined
         to be a bare repository or a top level repository clone.
     */
@@ -123,12 +128,28 @@ public:
         session& s,
         const boost::filesystem::path& pathname );
 
+    /** Identifies the content of *pathname* using the most appropriate
+        revision control system (see contentId). Files present
+        on the local filesystem are identified by their last modification
+        time and size. */
+    static std::string findRevContentId(
+        session& s,
+        const boost::filesystem::path& pathname );
+
     /** Load a text file using the most appropriate revision control
-        system based on *pathname* */
-    static slice<char> loadtext(
+        system based on *pathname*. The text is followed by a '\\0'
+        that is not part of the slice and is writable, as required
+        by the tokenizers and rapidxml. */
+    static sharedSlice<char> loadtext(
         session& s,
         const boost::filesystem::path& pathname );
 
+    /** returns a string that changes whenever the content of *pathname*
+        changes. For the metadir of a repository, it is the commit
+        HEAD points to. For a file or a directory, it is derived from
+        its last modification time (and size). */
+    static std::string stamp( const boost::filesystem::path& pathname );
+
 };
 
 class rev_directory_iterator;
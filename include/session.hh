@@ -27,6 +27,7 @@
 #define guardsession
 
 #include <map>
+#include <set>
 #include <boost/regex.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -196,9 +197,11 @@ public:
     typedef std::vector<url> inputsType;
     inputsType inputs;
 
+    typedef std::set<boost::filesystem::path> dependencySet;
+
 protected:
 
-    typedef std::map<boost::filesystem::path,slice<char> > textMap;
+    typedef std::map<boost::filesystem::path,sharedSlice<char> > textMap;
     typedef std::map<boost::filesystem::path,
                      RAPIDXML::xml_document<>* > xmlMap;
 
@@ -223,6 +226,12 @@ protected:
     void load( const boost::program_options::options_description& opts,
         const boost::filesystem::path& p, sourceType st );
 
+    /** Steps 4. to 6. of restoring a session, i.e. the (name,value)
+        pairs which are specific to a request. The content of a POST
+        request is read from *body* when not NULL, stdin otherwise.
+     */
+    void restoreRequest( std::istream *body );
+
 protected:
 
     /* \todo workout details of auth.cc first before making private. */
@@ -231,6 +240,10 @@ protected:
 
     std::ostream *ostr;
 
+    /** Files, directories and repositories the page being generated
+        depends on (NULL when dependencies are not tracked). */
+    dependencySet *deps;
+
     friend class sessionVariable;
 
     /* \todo protected comments.cc use of "href" */
@@ -291,6 +304,23 @@ public:
 
     void loadsession( const std::string& id );
 
+    /** Records *pathname* (a file, a directory or the metadir
+        of a repository) as a dependency of the page being generated.
+     */
+    void depends( const boost::filesystem::path& pathname ) {
+        if( deps ) deps->insert(pathname);
+    }
+
+    /** Starts recording the dependencies of the page being generated
+        into *d*, or stops recording them when *d* is NULL. Returns
+        the set dependencies were previously recorded into.
+     */
+    dependencySet *dependencies( dependencySet *d ) {
+        dependencySet *prev = deps;
+        deps = d;
+        return prev;
+    }
+
     /** Load and cache a text file in memory. Two back-to-back calls
         will return the same null-terminated buffer.
      */
@@ -354,8 +384,15 @@ public:
         the set of variables and restoring the session passing the same
         config arguments. This special-purpose implementation should
         be much more efficient.
+
+        All (name,value) pairs whose source is *from* or after
+        are removed.
     */
-    void reset();
+    void reset( sourceType from = unknown );
+
+    /** Release all text and xml files cached in memory.
+     */
+    void unload();
 
     /** (name,value) will be stored into the session file and thus
         persistent accross execution. */
@@ -387,6 +424,16 @@ public:
      */
     void restore( int argc, char *argv[] );
 
+    /** \brief Load the next request in a persistent process
+
+        The (name,value) pairs from the command-line and config file
+        loaded by a previous call to restore(argc,argv) are kept
+        while all other pairs and the files cached in memory are
+        discarded. Steps 4. to 6. are then executed against the CGI
+        environment variables of the request and its content *body*.
+     */
+    void restore( std::istream& body );
+
     /* Look for a relative *trigger* from *leaf* to *siteTop*
        and return the stem such that stem / *trigger* is the absolute
        url to the trigger.
@@ -30,6 +30,13 @@
 
 namespace tero {
 
+/** Sets *key* to the path of *pathname* relative to its project
+    and *log* to the lint log of that project. Returns false when
+    *pathname* is not a file inside a project under srcTop.
+*/
+bool lintSource( session& s, const boost::filesystem::path& pathname,
+    boost::filesystem::path& key, boost::filesystem::path& log );
+
 void shFetch( session& s, std::istream& in, const url& name );
 
 void shDiff( session& s, const url& name );
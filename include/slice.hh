@@ -28,6 +28,7 @@
 
 #include <cassert>
 #include <ostream>
+#include <boost/tr1/memory.hpp>
 
 /**
    Slice of text in memory.
@@ -75,6 +76,27 @@ public:
 };
 
 
+/** Slice that shares the ownership of the memory it points into.
+
+    The memory is released, through the deleter of *storage*,
+    when the last sharedSlice referencing it goes away.
+*/
+template<typename vT>
+class sharedSlice : public slice<vT> {
+public:
+    typedef std::tr1::shared_ptr<vT> storage_type;
+
+protected:
+    storage_type storage;
+
+public:
+    sharedSlice() {}
+
+    sharedSlice( const storage_type& s, vT* f, vT* l )
+        : slice<vT>(f,l), storage(s) {}
+};
+
+
 /** Shrink a slice of characters such as to discard leading
     and trailing whitespaces.
  */
@@ -165,6 +165,12 @@ void todoMeta( session& s, std::istream& in, const url& name );
  */
 void todoWriteHtmlFetch( session& s, const url& name );
 
+
+/** Fills *p* with the title and HTML printout of an item
+    out of a single parse of the file.
+ */
+void todoPost( session& s, post& p, const url& name );
+
 }
 
 #endif
@@ -26,6 +26,7 @@
 #ifndef guardtokenize
 #define guardtokenize
 
+#include <cstddef>
 #include <iterator>
 
 namespace tero {
@@ -37,6 +38,37 @@ namespace tero {
 */
 
 
+/** Implementations of scanFirstOf, either a portable byte loop or 
+    a loop over 16 (SSE2) or 32 (AVX2) bytes at a time. */
+enum scanMode {
+    scanAuto,
+    scanScalar,
+    scanSSE2,
+    scanAVX2
+};
+
+/** Selects the implementation of scanFirstOf. scanAuto picks the widest
+    instruction set the processor supports. When the processor lacks
+    the requested instruction set, the next narrower one is used instead.
+    Returns the implementation actually in use.
+*/
+scanMode selectScanMode( scanMode mode );
+
+/** Returns the implementation currently used by scanFirstOf. */
+scanMode currentScanMode();
+
+/** Returns a pointer to the first character in [first,last[ which is
+    one of the *n* characters in *stops* or *last* if there are none.
+
+    Tokenizers and decorators use this function to skip over long runs
+    of characters that they would otherwise process one at a time.
+    *stops* may contain '\0' and should be kept short (a few characters)
+    since each one adds a comparison per block of text.
+*/
+const char *scanFirstOf( const char *first, const char *last,
+    const char *stops, size_t n );
+
+
 enum cppToken {
     cppErr,
     cppBooleanLiteral,
@@ -372,6 +404,10 @@ public:
 
     void attach( xmlTokListener& l ) { listener = &l; }
 
+    /** Forgets the token in progress such that the next call starts
+        on a token boundary, as after a '>' or a line break. */
+    void reset() { trans = NULL; savedtrans = NULL; tok = xmlErr; }
+
     size_t tokenize( const char *line, size_t n );
 };
 
@@ -28,6 +28,8 @@
 
 #include <iomanip>
 #include <iostream>
+#include <streambuf>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 #include <boost/date_time/posix_time/ptime.hpp>
@@ -121,6 +123,9 @@ class httpHeaderSet {
 protected:
     bool firstTime;
 
+    /** incremented each time a header is set. */
+    size_t changes;
+
     std::string contentTypeValue;
     std::string contentTypeCharset;
     size_t contentLengthValue;
@@ -225,11 +230,79 @@ public:
         = boost::posix_time::ptime::date_duration_type(0) );
 
     httpHeaderSet& status( unsigned int s );
+
+    /** returns a number that changes whenever a header is set. */
+    size_t version() const { return changes; }
+
+    /** returns true once the headers have been written out. */
+    bool sent() const { return !firstTime; }
 };
 
 extern httpHeaderSet httpHeaders;
 
 
+/** Buffer for the response to a request.
+
+    The body of the response is kept in memory until the buffer
+    is full. At that point, httpHeaders is committed and the body
+    is streamed to the destination, without a Content-Length, from then
+    on, through the same, reused, buffer. If httpHeaders was changed after
+    the body started to be written, the headers written so far cannot
+    be trusted to be final and the whole response is buffered instead.
+
+    Once the headers are committed, the status of the response cannot
+    be changed anymore by finish().
+*/
+class responsebuf : public std::streambuf {
+protected:
+    enum stateType {
+        buffering,  /* nothing sent yet */
+        streaming,  /* headers sent, body sent as the buffer fills */
+        buffered    /* headers changed, everything is sent by finish() */
+    };
+
+    std::ostream *dest;
+
+    /** true when http headers are written before the body. */
+    bool withHeaders;
+
+    stateType state;
+
+    /** true once the first character of the body was written */
+    bool started;
+
+    /** httpHeaders.version() when the body started to be written */
+    size_t startVersion;
+
+    std::vector<char> buffer;
+
+    /** body held in the *buffered* state. */
+    std::string held;
+
+    void drain();
+
+    void commit( unsigned int status );
+
+    virtual int_type overflow( int_type c );
+
+    virtual int sync();
+
+public:
+    explicit responsebuf( size_t bufferSize = 64 * 1024 );
+
+    /** Starts a new response written to *d*. */
+    void open( std::ostream& d, bool headers );
+
+    /** Discards the body written so far. Returns false if some
+        of it was already sent. */
+    bool discard();
+
+    /** Sends headers, with the *status* code when they were not
+        committed yet, and the remaining of the body. */
+    void finish( unsigned int status );
+};
+
+
 class emptyParaHackType {
 public:
     template<typename ch, typename tr>
@@ -257,11 +330,21 @@ public:
 private:
     const boost::program_options::options_description* optDesc;
     const boost::program_options::positional_options_description* positionalDesc;
+    std::istream *istr;
 
 public:
     querySet query;
 
-    basic_cgi_parser() : optDesc(NULL), positionalDesc(NULL) {}
+    basic_cgi_parser()
+        : optDesc(NULL), positionalDesc(NULL), istr(NULL) {}
+
+    /** Sets the stream the content of a POST request is read from
+        (defaults to stdin).
+    */
+    basic_cgi_parser& input( std::istream& i ) {
+        istr = &i;
+        return *this;
+    }
 
     /** Sets options descriptions to use.
      */
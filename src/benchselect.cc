@@ -0,0 +1,152 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include <cstdlib>
+#include <iostream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "document.hh"
+
+/** Benchmark dispatchDoc::select, which matches a document name
+    against the compiled automaton, against the loop calling regex_match
+    on each pattern in turn it replaces.
+
+    usage: benchselect [iterations]
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace tero {
+
+extern dispatchDoc semDocs;
+
+}
+
+namespace {
+
+using namespace tero;
+
+/** Gives access to the dispatch table protected in dispatchDoc.
+ */
+struct dispatchTable : public dispatchDoc {
+    static fetchEntry *first( const dispatchDoc& d ) {
+        return d.*(&dispatchTable::entries);
+    }
+
+    static fetchEntry *last( const dispatchDoc& d ) {
+        return &(d.*(&dispatchTable::entries))[d.*(&dispatchTable::nbEntries)];
+    }
+};
+
+
+/** The implementation of dispatchDoc::select before patterns were compiled.
+ */
+const fetchEntry*
+selectLoop( const std::string& name, const std::string& value ) {
+    fetchEntry cmp;
+    cmp.name = name.c_str();
+    fetchEntry *lastEntry = dispatchTable::last(semDocs);
+    fetchEntry *first = std::lower_bound(dispatchTable::first(semDocs),
+        lastEntry,cmp);
+    fetchEntry *last = std::upper_bound(first,lastEntry,cmp);
+    for( fetchEntry *start = first; start != last; ++start ) {
+        boost::smatch m;
+        if( regex_match(value,m,start->pat) ) {
+            return start;
+        }
+    }
+    return NULL;
+}
+
+
+const char *samples[][2] = {
+    { "document", "/" },
+    { "document", "/index.rss" },
+    { "document", "/reps/semilla/src/document.cc" },
+    { "document", "/reps/semilla/include/document.hh" },
+    { "document", "/reps/semilla/Makefile" },
+    { "document", "/reps/semilla/src/document.cc/diff/"
+      "0123456789abcdef0123456789abcdef01234567" },
+    { "document", "/reps/semilla.git/index.rss" },
+    { "document", "/blog/tags-performance" },
+    { "document", "/reps/semilla/doc/internals.book" },
+    { "document", "/reps/semilla/data/themes/default/base.html" },
+    { "content", "/reps/semilla/src/session.cc" },
+    { "content", "/blog/2013-01-01-announce.blog" },
+    { "content", "/reps/semilla/tests/regression.xml" },
+    { "content", "/reps/semilla/dws.xml" },
+    { "title", "/reps/semilla/dws.xml" },
+    { "title", "/reps/semilla/src/session.cc" },
+    { "check", "/reps/semilla/src/session.cc" },
+    { "history", "/reps/semilla/src/session.cc" }
+};
+
+} // anonymous
+
+
+int main( int argc, char *argv[] )
+{
+    using namespace boost::posix_time;
+
+    int iterations = ( argc > 1 ) ? atoi(argv[1]) : 100000;
+    size_t nbSamples = sizeof(samples) / sizeof(samples[0]);
+
+    std::vector<std::string> names, values;
+    for( size_t i = 0; i < nbSamples; ++i ) {
+        names.push_back(samples[i][0]);
+        values.push_back(samples[i][1]);
+        if( semDocs.select(names.back(),values.back())
+            != selectLoop(names.back(),values.back()) ) {
+            std::cerr << "error: select(" << names.back() << ','
+                      << values.back() << ") differs from the loop."
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    size_t matches = 0;
+    ptime start = microsec_clock::universal_time();
+    for( int n = 0; n < iterations; ++n ) {
+        for( size_t i = 0; i < nbSamples; ++i ) {
+            if( selectLoop(names[i],values[i]) ) ++matches;
+        }
+    }
+    time_duration loop = microsec_clock::universal_time() - start;
+
+    start = microsec_clock::universal_time();
+    for( int n = 0; n < iterations; ++n ) {
+        for( size_t i = 0; i < nbSamples; ++i ) {
+            if( semDocs.select(names[i],values[i]) ) ++matches;
+        }
+    }
+    time_duration compiled = microsec_clock::universal_time() - start;
+
+    double selects = (double)iterations * nbSamples;
+    std::cout << "method\tns/select" << std::endl;
+    std::cout << "loop\t"
+              << loop.total_microseconds() * 1000.0 / selects << std::endl;
+    std::cout << "compiled\t"
+              << compiled.total_microseconds() * 1000.0 / selects << std::endl;
+    return ( matches > 0 ) ? 0 : 1;
+}
@@ -0,0 +1,499 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "tokenize.hh"
+#include "booktok.hh"
+#include "markdown.hh"
+#include "rfc2822tok.hh"
+#include "rfc5545tok.hh"
+
+/** Benchmark the tokenizers over generated corpora representative
+    of the files semilla presents: C++ headers, shell scripts, build logs,
+    mbox archives, calendars, docbook and markdown documents.
+
+    usage: benchtokenizers [--size=MB] [--seconds=S] [name=file ...]
+
+    A *name=file* argument replaces the generated corpus for tokenizer
+    *name* by the content of *file* (repeated up to the corpus size).
+    The results are printed one tokenizer per line, tab separated,
+    such that runs before and after a change can be compared with
+    standard tools.
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace {
+
+/* Number of calls to operator new since the program started. */
+unsigned long allocations = 0;
+
+}
+
+/* Dynamic exception specifications are deprecated in C++11
+   and removed in C++17. */
+#if __cplusplus < 201103L
+#define throwsBadAlloc throw(std::bad_alloc)
+#define throwsNothing throw()
+#else
+#define throwsBadAlloc
+#define throwsNothing noexcept
+#endif
+
+void* operator new( size_t size ) throwsBadAlloc {
+    ++allocations;
+    void *p = malloc(size > 0 ? size : 1);
+    if( p == NULL ) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[]( size_t size ) throwsBadAlloc {
+    ++allocations;
+    void *p = malloc(size > 0 ? size : 1);
+    if( p == NULL ) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete( void *p ) throwsNothing {
+    free(p);
+}
+
+void operator delete[]( void *p ) throwsNothing {
+    free(p);
+}
+
+
+namespace {
+
+using namespace tero;
+
+/** Deterministic pseudo-random numbers such that corpora are the same
+    from one run to the next. */
+class generator {
+protected:
+    unsigned long long seed;
+
+public:
+    explicit generator( unsigned long long s ) : seed(s) {}
+
+    unsigned int next( unsigned int n ) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (unsigned int)(seed >> 33) % n;
+    }
+
+    const char *pick( const char *words[], size_t n ) {
+        return words[next(n)];
+    }
+
+    void identifier( std::ostream& o ) {
+        static const char *parts[] = {
+            "session", "text", "buf", "first", "last", "line", "token",
+            "decorator", "path", "value", "next", "count", "url", "post" };
+        o << pick(parts, sizeof(parts) / sizeof(parts[0]));
+        if( next(3) == 0 ) o << pick(parts, sizeof(parts) / sizeof(parts[0]));
+    }
+
+    void words( std::ostream& o, unsigned int n ) {
+        static const char *vocabulary[] = {
+            "the", "tokenizer", "reads", "a", "stream", "of", "characters",
+            "and", "calls", "listener", "for", "each", "token", "it",
+            "recognizes", "in", "presentation", "engine", "with", "files" };
+        for( unsigned int i = 0; i < n; ++i ) {
+            if( i > 0 ) o << ' ';
+            o << pick(vocabulary, sizeof(vocabulary) / sizeof(vocabulary[0]));
+        }
+    }
+};
+
+
+typedef void (*corpusFunc)( std::ostream&, generator& );
+
+
+void cppCorpus( std::ostream& o, generator& g ) {
+    o << "/** Doc comment for a class template, describing ";
+    g.words(o, 12);
+    o << "\n */\ntemplate<typename charT, typename traitsT = std::char_traits<charT> >\n"
+      << "class basic";
+    g.identifier(o);
+    o << " : public std::basic_ostream<charT, traitsT> {\nprotected:\n";
+    for( unsigned int i = 0, n = 2 + g.next(6); i < n; ++i ) {
+        o << "    size_t ";
+        g.identifier(o);
+        o << ";  // ";
+        g.words(o, 5);
+        o << '\n';
+    }
+    o << "\npublic:\n    int ";
+    g.identifier(o);
+    o << "( const char *line, int first, int last ) {\n";
+    for( unsigned int i = 0, n = 3 + g.next(8); i < n; ++i ) {
+        switch( g.next(5) ) {
+        case 0:
+            o << "        if( first < last && line[first] == '\\n' ) return 0x"
+              << std::hex << g.next(65536) << std::dec << ";\n";
+            break;
+        case 1:
+            o << "        std::cerr << \"error: \\\"" ;
+            g.words(o, 4);
+            o << "\\\"\" << std::endl;\n";
+            break;
+        case 2:
+            o << "        double ratio = " << g.next(1000) << '.'
+              << g.next(100) << "e-3 * (last - first);\n";
+            break;
+        case 3:
+            o << "#if 0\n        /* disabled */\n#endif\n";
+            break;
+        default:
+            o << "        ";
+            g.identifier(o);
+            o << " += std::distance(&line[first], &line[last]);\n";
+        }
+    }
+    o << "        return last - first;\n    }\n};\n\n";
+}
+
+
+void shCorpus( std::ostream& o, generator& g ) {
+    o << "# ";
+    g.words(o, 8);
+    o << "\nfor f in $(ls " << "src/*.cc); do\n"
+      << "    if [ -f \"$f\" ] ; then\n"
+      << "        echo \"processing $f\" >> log.txt  # ";
+    g.words(o, 3);
+    o << "\n        g++ -c -O2 $f -o ${f%.cc}.o || exit " << g.next(4) << "\n"
+      << "    fi\ndone\n"
+      << "PATH=/usr/local/bin:$PATH make -j" << 1 + g.next(8) << " install\n\n";
+}
+
+
+void errCorpus( std::ostream& o, generator& g ) {
+    o << "g++ -g -Wall -Iinclude -c src/";
+    g.identifier(o);
+    o << ".cc\n";
+    for( unsigned int i = 0, n = 1 + g.next(4); i < n; ++i ) {
+        o << "src/";
+        g.identifier(o);
+        o << ".cc:" << 1 + g.next(2000) << ':' << 1 + g.next(80) << ": "
+          << ( g.next(3) == 0 ? "error" : "warning" ) << ": ";
+        g.words(o, 6 + g.next(6));
+        o << '\n';
+    }
+    o << "make[1]: Leaving directory `/home/build/semilla'\n";
+}
+
+
+void hrefCorpus( std::ostream& o, generator& g ) {
+    g.words(o, 5 + g.next(8));
+    o << " include/";
+    g.identifier(o);
+    o << ".hh and src/";
+    g.identifier(o);
+    o << ".cc ";
+    g.words(o, 3 + g.next(6));
+    o << " /var/www/reps/semilla/Makefile\n";
+}
+
+
+void xmlCorpus( std::ostream& o, generator& g ) {
+    o << "<div class=\"";
+    g.identifier(o);
+    o << "\" id='n" << g.next(1000) << "'>\n  <p>";
+    g.words(o, 10 + g.next(20));
+    o << " &amp; <a href=\"/reps/semilla/src/";
+    g.identifier(o);
+    o << ".cc\">";
+    g.words(o, 2);
+    o << "</a></p>\n  <!-- ";
+    g.words(o, 4);
+    o << " -->\n  <img src=\"/static/logo.png\" alt=\"logo\"/>\n</div>\n";
+}
+
+
+void xmlescCorpus( std::ostream& o, generator& g ) {
+    g.words(o, 8 + g.next(16));
+    switch( g.next(4) ) {
+    case 0:
+        o << " if( a < b && c > d ) return \"quoted\";";
+        break;
+    case 1:
+        o << " AT&T";
+        break;
+    }
+    o << '\n';
+}
+
+
+void rfc2822Corpus( std::ostream& o, generator& g ) {
+    unsigned int day = 1 + g.next(28);
+    o << "From ";
+    g.identifier(o);
+    o << "@fortylines.com Mon Jan " << day << " 10:00:00 2011\n"
+      << "From: ";
+    g.identifier(o);
+    o << " <";
+    g.identifier(o);
+    o << "@fortylines.com>\nTo: semilla@fortylines.com\n"
+      << "Date: Mon, " << day << " Jan 2011 10:" << 10 + g.next(50)
+      << ":00 -0800\nSubject: ";
+    g.words(o, 5);
+    o << "\nMessage-ID: <" << g.next(100000) << "@fortylines.com>\n"
+      << "Content-Type: text/plain; charset=us-ascii\n\n";
+    for( unsigned int i = 0, n = 3 + g.next(12); i < n; ++i ) {
+        g.words(o, 6 + g.next(8));
+        o << '\n';
+    }
+    o << '\n';
+}
+
+
+void rfc5545Corpus( std::ostream& o, generator& g ) {
+    unsigned int day = 10 + g.next(18);
+    o << "BEGIN:VEVENT\nUID:" << g.next(1000000) << "@fortylines.com\n"
+      << "DTSTART;TZID=America/Los_Angeles:201101" << day << "T090000\n"
+      << "DTEND;TZID=America/Los_Angeles:201101" << day << "T100000\n"
+      << "SUMMARY:";
+    g.words(o, 4);
+    o << "\nDESCRIPTION:";
+    g.words(o, 10);
+    o << "\n ";
+    g.words(o, 8);
+    o << "\nLOCATION:Room " << g.next(100) << "\nEND:VEVENT\n";
+}
+
+
+void bookCorpus( std::ostream& o, generator& g ) {
+    o << "<section>\n<title>";
+    g.words(o, 3);
+    o << "</title>\n<para>\n";
+    g.words(o, 20 + g.next(20));
+    o << " <emphasis>";
+    g.words(o, 2);
+    o << "</emphasis> <ulink url=\"http://fortylines.com/\">";
+    g.words(o, 1);
+    o << "</ulink>.\n</para>\n<programlisting>\nmake install\n"
+      << "</programlisting>\n</section>\n";
+}
+
+
+void markdownCorpus( std::ostream& o, generator& g ) {
+    o << "## ";
+    g.words(o, 4);
+    o << "\n\n";
+    g.words(o, 12 + g.next(20));
+    o << " *";
+    g.words(o, 2);
+    o << "* and `code`.\n\n- ";
+    g.words(o, 5);
+    o << "\n- [link](http://fortylines.com/)\n\n";
+}
+
+
+/** Counts the tokens seen by a tokenizer. */
+template<typename listenerT, typename tokenT>
+class tokenCounter : public listenerT {
+public:
+    unsigned long tokens;
+
+    tokenCounter() : tokens(0) {}
+
+    void newline( const char *line, int first, int last ) {
+        ++tokens;
+    }
+
+    void token( tokenT token, const char *line,
+        int first, int last, bool fragment ) {
+        ++tokens;
+    }
+};
+
+
+/** Runs a tokenizer *tokenizerT* with a listener *listenerT* over
+    the text once and returns the number of tokens.
+
+    Some tokenizers (ex. rfc2822) return after each message. As in
+    mailParser::addFile, a new tokenizer then picks up where the previous
+    one stopped. */
+template<typename tokenizerT, typename listenerT, typename tokenT>
+unsigned long tokenizeOnce( std::string& text ) {
+    tokenCounter<listenerT,tokenT> counter;
+    const char *start = text.c_str();
+    size_t length = text.size();
+    while( length > 0 ) {
+        tokenizerT tokenizer(counter);
+        size_t processed = tokenizer.tokenize(start, length);
+        /* shTokenizer counts the terminating '\0' as processed. */
+        if( processed == 0 || processed >= length ) break;
+        start += processed;
+        length -= processed;
+    }
+    return counter.tokens;
+}
+
+
+unsigned long docbookOnce( std::string& text ) {
+    docbookBufferTokenizer tokenizer(&text[0], text.size());
+    unsigned long tokens = 0;
+    while( tokenizer.read() != bookEof ) ++tokens;
+    return tokens;
+}
+
+
+typedef unsigned long (*runFunc)( std::string& );
+
+struct benchEntry {
+    const char *name;
+    corpusFunc corpus;
+    runFunc run;
+};
+
+const benchEntry benches[] = {
+    { "cpp", cppCorpus,
+      tokenizeOnce<cppTokenizer,cppTokListener,cppToken> },
+    { "sh", shCorpus,
+      tokenizeOnce<shTokenizer,shTokListener,shToken> },
+    { "err", errCorpus,
+      tokenizeOnce<errTokenizer,errTokListener,errToken> },
+    { "href", hrefCorpus,
+      tokenizeOnce<hrefTokenizer,hrefTokListener,hrefToken> },
+    { "xml", xmlCorpus,
+      tokenizeOnce<xmlTokenizer,xmlTokListener,xmlToken> },
+    { "xmlesc", xmlescCorpus,
+      tokenizeOnce<xmlEscTokenizer,xmlEscTokListener,xmlEscToken> },
+    { "rfc2822", rfc2822Corpus,
+      tokenizeOnce<rfc2822Tokenizer,rfc2822TokListener,rfc2822Token> },
+    { "rfc5545", rfc5545Corpus,
+      tokenizeOnce<rfc5545Tokenizer,rfc5545TokListener,rfc5545Token> },
+    { "book", bookCorpus, docbookOnce },
+    { "markdown", markdownCorpus,
+      tokenizeOnce<mdTokenizer,mdTokListener,mdToken> }
+};
+
+
+/** Fills *text* with at least *size* bytes, either generated
+    or repeated from the content of *filename*. */
+void makeCorpus( std::string& text, size_t size,
+    const benchEntry& bench, const std::string& filename )
+{
+    std::stringstream corpus;
+    if( !filename.empty() ) {
+        std::ifstream file(filename.c_str());
+        std::stringstream content;
+        content << file.rdbuf();
+        if( content.str().empty() ) {
+            std::cerr << "error: cannot read " << filename << std::endl;
+            exit(1);
+        }
+        while( corpus.tellp() < (std::streamoff)size ) {
+            corpus << content.str();
+        }
+    } else {
+        generator g(0x5e3111aULL);
+        while( corpus.tellp() < (std::streamoff)size ) {
+            bench.corpus(corpus, g);
+        }
+    }
+    text = corpus.str();
+}
+
+} // anonymous
+
+
+int main( int argc, char *argv[] )
+{
+    using namespace boost::posix_time;
+
+    size_t size = 4 * 1024 * 1024;
+    double minSeconds = 1.0;
+    size_t nbBenches = sizeof(benches) / sizeof(benches[0]);
+    std::vector<std::string> corpora(nbBenches);
+
+    for( int i = 1; i < argc; ++i ) {
+        std::string arg(argv[i]);
+        if( arg.compare(0,7,"--size=") == 0 ) {
+            size = (size_t)(atof(arg.c_str() + 7) * 1024 * 1024);
+        } else if( arg.compare(0,10,"--seconds=") == 0 ) {
+            minSeconds = atof(arg.c_str() + 10);
+        } else {
+            size_t sep = arg.find('=');
+            size_t b = 0;
+            while( b < nbBenches && arg.compare(0,sep,benches[b].name) != 0 ) {
+                ++b;
+            }
+            if( sep == std::string::npos || b == nbBenches ) {
+                std::cerr << "usage: " << argv[0]
+                          << " [--size=MB] [--seconds=S] [name=file ...]"
+                          << std::endl;
+                return 1;
+            }
+            corpora[b] = arg.substr(sep + 1);
+        }
+    }
+
+    static const char *modes[] = { "auto", "scalar", "sse2", "avx2" };
+    std::cout << "# scanFirstOf: " << modes[currentScanMode()] << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "tokenizer\tbytes\titerations\tseconds\tMB/s"
+              << "\ttokens/s\tallocs/MB" << std::endl;
+    for( size_t b = 0; b < nbBenches; ++b ) {
+        std::string text;
+        makeCorpus(text, size, benches[b], corpora[b]);
+
+        /* warm up caches and lazily initialized tables. */
+        unsigned long tokens = benches[b].run(text);
+        if( tokens == 0 ) {
+            std::cerr << "error: no tokens out of the " << benches[b].name
+                      << " corpus." << std::endl;
+            return 1;
+        }
+
+        unsigned long iterations = 0;
+        unsigned long startAllocs = allocations;
+        ptime start = microsec_clock::universal_time();
+        time_duration elapsed;
+        do {
+            benches[b].run(text);
+            ++iterations;
+            elapsed = microsec_clock::universal_time() - start;
+        } while( elapsed.total_microseconds() < minSeconds * 1000000 );
+
+        double seconds = elapsed.total_microseconds() / 1000000.0;
+        double megabytes = (double)text.size() * iterations / (1024 * 1024);
+        std::cout << benches[b].name << '\t' << text.size()
+                  << '\t' << iterations << '\t' << seconds
+                  << '\t' << megabytes / seconds
+                  << '\t' << (double)tokens * iterations / seconds
+                  << '\t' << (allocations - startAllocs) / megabytes
+                  << std::endl;
+    }
+    return 0;
+}
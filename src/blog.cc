@@ -23,20 +23,416 @@
    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <iomanip>
+#include <unistd.h>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/regex.hpp>
 #include "blog.hh"
 #include "mail.hh"
-#include <boost/regex.hpp>
+#include "revsys.hh"
 
 /** Pages related to blog posts.
 
     Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
 */
 
+namespace {
+
+/* Field values are stored one per line in an index file. */
+std::string escape( const std::string& value )
+{
+    std::string result;
+    result.reserve(value.size());
+    for( std::string::const_iterator c = value.begin();
+         c != value.end(); ++c ) {
+        switch( *c ) {
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        default:
+            result += *c;
+            break;
+        }
+    }
+    return result;
+}
+
+
+std::string unescape( const std::string& value )
+{
+    std::string result;
+    result.reserve(value.size());
+    for( std::string::const_iterator c = value.begin();
+         c != value.end(); ++c ) {
+        if( *c == '\\' && c + 1 != value.end() ) {
+            ++c;
+            result += ( *c == 'n' ) ? '\n' : *c;
+        } else {
+            result += *c;
+        }
+    }
+    return result;
+}
+
+
+bool sameTime( const boost::posix_time::ptime& left,
+    const boost::posix_time::ptime& right )
+{
+    /* not-a-date-time never compares equal to itself. */
+    return left == right
+        || (left.is_not_a_date_time() && right.is_not_a_date_time());
+}
+
+} // anonymous
+
+
 namespace tero {
 
 char blogPat[] = ".*\\.blog$";
 const char *blogTrigger = "blog";
 
+pathVariable blogIndexDir("blogIndexDir",
+    "directory where the metadata of blog posts is indexed (empty keeps the index in memory only)");
+
+
+void
+blogAddSessionVars( boost::program_options::options_description& opts,
+    boost::program_options::options_description& visible )
+{
+    using namespace boost::program_options;
+
+    options_description localOptions("blog");
+    localOptions.add(blogIndexDir.option());
+    opts.add(localOptions);
+}
+
+
+/** Parses the files whose stamp changed since they were last indexed.
+ */
+class blogIndexer : public dirwalker {
+protected:
+    blogIndex& index;
+
+    virtual void
+    addFile( session& s, const boost::filesystem::path& pathname ) const;
+
+public:
+    /* files found while walking the directory */
+    mutable std::set<boost::filesystem::path> seen;
+
+    /* true when the index was modified */
+    mutable bool changed;
+
+    blogIndexer( const boost::regex& fm, blogIndex& i )
+        : dirwalker(fm), index(i), changed(false) {}
+
+    /** Indexes the files directly inside *dirname*
+        without descending into sub-directories. */
+    void fetchFlat( session& s, const boost::filesystem::path& dirname );
+};
+
+
+void
+blogIndexer::addFile( session& s, const boost::filesystem::path& filename ) const
+{
+    seen.insert(filename);
+    std::string stamp = revisionsys::findRevContentId(s, filename);
+    blogIndex::fileMap::const_iterator found = index.files.find(filename);
+    if( found != index.files.end()
+        && !stamp.empty() && found->second.stamp == stamp ) {
+        /* The file is not loaded but pages built out of the index
+           still depend on it. */
+        s.depends(filename);
+        return;
+    }
+
+    blogIndex::fileEntry& file = index.files[filename];
+    file.stamp = stamp;
+    file.posts.clear();
+    changed = true;
+
+    std::string guid = s.asUrl(filename).string();
+    slice<char> text = s.loadtext(filename);
+    char *start = text.begin();
+    size_t length = text.size();
+    while( length > 0 ) {
+        mailAsPost listener;
+        rfc2822Tokenizer tok(listener);
+        size_t processed = tok.tokenize(start, length);
+        if( processed == 0 ) break;
+        if( listener.nontrivial ) {
+            blogIndex::entry e;
+            listener.unserialized(e.meta);
+            e.meta.content.clear();
+            e.meta.filename = filename;
+            e.meta.guid = guid;
+            e.offset = std::distance(text.begin(), start);
+            e.length = processed;
+            file.posts.push_back(e);
+        }
+        start += processed;
+        length -= processed;
+    }
+}
+
+
+boost::filesystem::path
+blogIndex::storePath( const boost::filesystem::path& dir ) const
+{
+    /* FNV-1a. The full key is stored in the index to detect collisions. */
+    unsigned long long hash = 14695981039346656037ULL;
+    for( std::string::const_iterator c = key.begin(); c != key.end(); ++c ) {
+        hash ^= (unsigned char)*c;
+        hash *= 1099511628211ULL;
+    }
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash << ".idx";
+    return dir / name.str();
+}
+
+
+bool blogIndex::load( const boost::filesystem::path& dir )
+{
+    using namespace boost::posix_time;
+
+    boost::filesystem::ifstream strm(storePath(dir));
+    std::string line;
+    if( !std::getline(strm,line) || line != "semilla-blogindex 1"
+        || !std::getline(strm,line) || line != key ) {
+        return false;
+    }
+
+    fileMap loaded;
+    boost::filesystem::path filename;
+    fileEntry *file = NULL;
+    entry *e = NULL;
+    while( std::getline(strm,line) ) {
+        size_t sep = line.find(' ');
+        std::string field = line.substr(0,sep);
+        std::string value = ( sep != std::string::npos ) ?
+            line.substr(sep + 1) : std::string();
+        if( field == "file" ) {
+            filename = unescape(value);
+            file = &loaded[filename];
+            e = NULL;
+        } else if( file == NULL ) {
+            return false;
+        } else if( field == "stamp" ) {
+            file->stamp = unescape(value);
+        } else if( field == "post" ) {
+            file->posts.push_back(entry());
+            e = &file->posts.back();
+            e->meta.filename = filename;
+            e->meta.score = 0;
+            std::istringstream range(value);
+            if( !(range >> e->offset >> e->length) ) return false;
+        } else if( e == NULL ) {
+            return false;
+        } else if( field == "guid" ) {
+            e->meta.guid = unescape(value);
+        } else if( field == "time" ) {
+            if( value != "-" ) {
+                try {
+                    e->meta.time = from_iso_string(value);
+                } catch( std::exception& ) {
+                    return false;
+                }
+            }
+        } else if( field == "title" ) {
+            e->meta.title = unescape(value);
+        } else if( field == "score" ) {
+            e->meta.score = atoi(value.c_str());
+        } else if( field == "author" ) {
+            e->meta.author = contrib::find(unescape(value));
+        } else if( field == "header" ) {
+            size_t nameSep = value.find(' ');
+            if( nameSep == std::string::npos ) return false;
+            e->meta.moreHeaders[value.substr(0,nameSep)]
+                = unescape(value.substr(nameSep + 1));
+        } else if( e->meta.author && !value.empty() ) {
+            /* Contributors are shared between posts so profile fields
+               are set on a copy owned by this post. */
+            if( field == "authorName" ) {
+                e->meta.author = contrib::find(e->meta.author->email,
+                    unescape(value));
+            } else if( field == "google" ) {
+                e->meta.author.reset(new contrib(*e->meta.author));
+                e->meta.author->google = unescape(value);
+            } else if( field == "linkedin" ) {
+                e->meta.author.reset(new contrib(*e->meta.author));
+                e->meta.author->linkedin = unescape(value);
+            }
+        }
+    }
+    files.swap(loaded);
+    return true;
+}
+
+
+void blogIndex::store( const boost::filesystem::path& dir ) const
+{
+    using namespace boost::filesystem;
+    using namespace boost::posix_time;
+
+    path pathname = storePath(dir);
+    std::stringstream tmpname;
+    tmpname << pathname.string() << '.' << getpid();
+    path tmp(tmpname.str());
+    {
+        ofstream strm(tmp);
+        strm << "semilla-blogindex 1\n" << key << '\n';
+        for( fileMap::const_iterator f = files.begin();
+             f != files.end(); ++f ) {
+            strm << "file " << escape(f->first.string()) << '\n'
+                 << "stamp " << escape(f->second.stamp) << '\n';
+            for( entryList::const_iterator e = f->second.posts.begin();
+                 e != f->second.posts.end(); ++e ) {
+                const post& p = e->meta;
+                strm << "post " << e->offset << ' ' << e->length << '\n'
+                     << "guid " << escape(p.guid) << '\n'
+                     << "time " << ( p.time.is_special() ?
+                         std::string("-") : to_iso_string(p.time)) << '\n'
+                     << "title " << escape(p.title) << '\n'
+                     << "score " << p.score << '\n';
+                if( p.author ) {
+                    strm << "author " << escape(p.author->email) << '\n'
+                         << "authorName " << escape(p.author->name) << '\n'
+                         << "google " << escape(p.author->google) << '\n'
+                         << "linkedin " << escape(p.author->linkedin) << '\n';
+                }
+                for( post::headersMap::const_iterator
+                         h = p.moreHeaders.begin();
+                     h != p.moreHeaders.end(); ++h ) {
+                    strm << "header " << h->first
+                         << ' ' << escape(h->second) << '\n';
+                }
+            }
+        }
+        if( !strm.good() ) {
+            strm.close();
+            boost::system::error_code ec;
+            remove(tmp,ec);
+            return;
+        }
+    }
+    /* rename is atomic such that concurrent requests either see
+       the previous index or the complete new one. */
+    boost::system::error_code ec;
+    rename(tmp,pathname,ec);
+    if( ec ) remove(tmp,ec);
+}
+
+
+void
+blogIndexer::fetchFlat( session& s, const boost::filesystem::path& dirname )
+{
+    using namespace boost::filesystem;
+
+    s.depends(dirname);
+    boost::system::error_code ec;
+    for( directory_iterator entry = directory_iterator(dirname,ec);
+         entry != directory_iterator(); entry.increment(ec) ) {
+        if( ec ) break;
+        path filename(*entry);
+        if( is_regular_file(filename,ec) && selects(filename) ) {
+            addFile(s, filename);
+        }
+    }
+}
+
+
+blogIndex& blogIndex::refresh( session& s,
+    const boost::filesystem::path& blogroot, const char *filePat,
+    bool recursive )
+{
+    typedef std::map<std::string,blogIndex> indexMap;
+    static indexMap indices;
+
+    /* guids are derived from the location of files in the site. */
+    std::stringstream key;
+    key << filePat << '\t' << blogroot.string()
+        << '\t' << s.valueOf(siteTop.name) << (recursive ? "" : "\tflat");
+
+    boost::filesystem::path dir;
+    session::variables::const_iterator look = s.find(blogIndexDir.name);
+    if( s.found(look) && !look->second.value.empty() ) {
+        dir = blogIndexDir.value(s);
+    }
+
+    indexMap::iterator found = indices.find(key.str());
+    if( found == indices.end() ) {
+        found = indices.insert(std::make_pair(key.str(), blogIndex())).first;
+        found->second.key = key.str();
+        if( !dir.empty() ) found->second.load(dir);
+    }
+    blogIndex& index = found->second;
+
+    blogIndexer indexer(boost::regex(filePat), index);
+    if( recursive ) {
+        indexer.fetch(s, blogroot);
+    } else {
+        indexer.fetchFlat(s, blogroot);
+    }
+    for( fileMap::iterator f = index.files.begin(); f != index.files.end(); ) {
+        if( indexer.seen.find(f->first) == indexer.seen.end() ) {
+            index.files.erase(f++);
+            indexer.changed = true;
+        } else {
+            ++f;
+        }
+    }
+    if( indexer.changed && !dir.empty() ) {
+        index.store(dir);
+    }
+    return index;
+}
+
+
+void blogIndex::feed( postFilter& filter, bool firstOnly ) const
+{
+    for( fileMap::const_iterator f = files.begin(); f != files.end(); ++f ) {
+        for( entryList::const_iterator e = f->second.posts.begin();
+             e != f->second.posts.end(); ++e ) {
+            filter.filters(e->meta);
+            if( firstOnly ) break;
+        }
+    }
+}
+
+
+bool blogIndex::content( session& s, post& p ) const
+{
+    fileMap::const_iterator file = files.find(p.filename);
+    if( file == files.end() ) return false;
+
+    /* Filters pass copies of the posts fed out of the index
+       so a post is recognized by its time and title within its file. */
+    for( entryList::const_iterator e = file->second.posts.begin();
+         e != file->second.posts.end(); ++e ) {
+        if( sameTime(e->meta.time, p.time) && e->meta.title == p.title ) {
+            slice<char> text = s.loadtext(p.filename);
+            if( e->offset >= text.size() ) return false;
+            mailAsPost listener;
+            rfc2822Tokenizer tok(listener);
+            tok.tokenize(text.begin() + e->offset, text.size() - e->offset);
+            p.content = listener.unserialized().content;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void blogContentLoader::filters( const post& v )
+{
+    post p = v;
+    index->content(*s, p);
+    if( next ) next->filters(p);
+}
+
 
 void mostRecentFilter::filters( const post& p )
 {
@@ -56,8 +452,7 @@ mostRecentBlogEntry( session& s, const url& name )
         s.root(name, blogTrigger, true));
 
     mostRecentFilter mostRecent(NULL);
-    mailParser walker(boost::regex(blogPat), mostRecent, true);
-    walker.fetch(s, blogroot);
+    blogIndex::refresh(s, blogroot, blogPat).feed(mostRecent, true);
     return s.asUrl(mostRecent.mostRecent().filename);
 }
 
@@ -108,9 +503,7 @@ void mostRecentBlogTitle( session& s, const url& name )
     mailAsPost listener;
     rfc2822Tokenizer tok(listener);
     tok.tokenize(text.begin(),text.size());
-    post p = listener.unserialized();
-
-    s.out() << p.title;
+    s.out() << listener.unserialized().title;
 }
 
 
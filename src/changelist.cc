@@ -24,6 +24,7 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include <cstdio>
+#include <cstring>
 #include "document.hh"
 #include "changelist.hh"
 #include "markup.hh"
@@ -39,6 +40,8 @@
 namespace tero {
 
 pathVariable binDir("binDir","path to external executables");
+pathVariable logIndexDir("logIndexDir",
+    "directory where commit indices of repositories are stored (defaults to sessionDir/logs)");
 
 void
 changelistAddSessionVars( boost::program_options::options_description& all,
@@ -48,6 +51,7 @@ changelistAddSessionVars( boost::program_options::options_description& all,
 
     options_description localOptions("changelist");
     localOptions.add(binDir.option());
+    localOptions.add(logIndexDir.option());
     all.add(localOptions);
     visible.add(localOptions);
 }
@@ -117,30 +121,34 @@ void changediff( session& s, const boost::filesystem::path& pathname,
 {
     using namespace std;
 
-    std::stringstream text;
-
     revisionsys *rev = revisionsys::findRev(s,pathname);
     if( rev != NULL ) {
-        boost::filesystem::path
-            gitrelname = rev->relative(pathname);
-        rev->diff(text,leftRevision,rightRevision,gitrelname);
+        boost::filesystem::path relname
+            = ( strncmp(rev->metadir, "fs", 2) != 0 ) ?
+            rev->relative(pathname) : pathname;
+
+        /* The left revision is optional and matched along with
+           its trailing '/'. Without it, the left side is the text
+           currently checked out. */
+        std::string leftCommit = leftRevision;
+        if( !leftCommit.empty() && leftCommit[leftCommit.size() - 1] == '/' ) {
+            leftCommit.erase(leftCommit.size() - 1);
+        }
+        sharedSlice<char> left = leftCommit.empty() ?
+            revisionsys::loadtext(s, pathname)
+            : rev->loadtext(relname, leftCommit);
+        sharedSlice<char> right = rev->loadtext(relname, rightRevision);
 
         s.out() << "<table style=\"text-align: left;\">" << endl;
         s.out() << html::tr();
-        s.out() << html::th() << leftRevision << html::th::end;
+        s.out() << html::th() << leftCommit << html::th::end;
         s.out() << html::th() << rightRevision << html::th::end;
         s.out() << html::tr::end;
 
-        /* XXX Handle revys here as well? */
-        std::streambuf *buf = revisionsys::findRevOpenfile(s, pathname);
-        if( buf ) {
-            std::istream input(buf);
-            /* \todo the session is not a parameter to between files... */
-            tero::text doc(*primary,*secondary);
-            doc.showSideBySide(s,input,text,false);
-            s.out() << html::table::end;
-            delete buf;
-        }
+        /* \todo the session is not a parameter to between files... */
+        tero::text doc(*primary,*secondary);
+        doc.showSideBySide(s,left,right);
+        s.out() << html::table::end;
     }
 }
 
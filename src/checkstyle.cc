@@ -23,6 +23,12 @@
    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include <boost/filesystem/fstream.hpp>
 #include "document.hh"
 #include "checkstyle.hh"
 #include "markup.hh"
@@ -37,57 +43,98 @@
 
 namespace {
 
-class errTokWriter : public tero::errTokListener {
-public:
-	typedef std::map<int,std::string> annotationsType;
-	annotationsType& annotations;
-	boost::filesystem::path filename;
-	bool record;
-	int lineNum;
-	std::string frag;
+/* Words made only of comment decoration are not part of a license. */
+bool decoration( const char *first, const char *last ) {
+    for( ; first != last; ++first ) {
+        if( *first != '/' && *first != '*' && *first != '#' ) return false;
+    }
+    return true;
+}
 
-public:
-	explicit errTokWriter( annotationsType& a,
-						   const boost::filesystem::path& f ) 
-		: annotations(a), filename(f), record(false) {}
 
-    void newline( const char *line, int first, int last ) {
+size_t hashWord( const char *first, const char *last ) {
+    /* FNV-1a */
+    size_t h = 2166136261u;
+    for( ; first != last; ++first ) {
+        h = (h ^ (unsigned char)*first) * 16777619u;
+    }
+    return h;
+}
+
+
+/* Multiplier of the polynomial rolling hash over word hashes. */
+const size_t wordBase = 1000003u;
+
+typedef std::vector<tero::slice<const char> > wordList;
+
+
+void splitWords( wordList& words, const char *first, const char *last ) {
+    while( first != last ) {
+        while( first != last && isspace(*first) ) ++first;
+        const char *word = first;
+        while( first != last && !isspace(*first) ) ++first;
+        if( word != first && !decoration(word, first) ) {
+            words.push_back(tero::slice<const char>(word, first));
+        }
+    }
+}
+
+
+bool sameSlice( const tero::slice<const char>& left,
+    const tero::slice<const char>& right ) {
+    return left.size() == right.size()
+        && memcmp(left.begin(), right.begin(), left.size()) == 0;
+}
+
+
+bool sameWord( const tero::slice<const char>& word, const char *text ) {
+    size_t len = strlen(text);
+    return word.size() == len && memcmp(word.begin(), text, len) == 0;
+}
+
+
+/* Dates are written as \d+(-\d+)? followed by a comma. */
+bool isDates( const tero::slice<const char>& word ) {
+    const char *p = word.begin();
+    const char *last = word.end();
+    if( p == last || last[-1] != ',' ) return false;
+    --last;
+    const char *digits = p;
+    while( p != last && isdigit(*p) ) ++p;
+    if( p == digits ) return false;
+    if( p != last && *p == '-' ) {
+        digits = ++p;
+        while( p != last && isdigit(*p) ) ++p;
+        if( p == digits ) return false;
     }
-    
-    void token( tero::errToken token, const char *line, 
-				int first, int last, bool fragment ) {
-		if( fragment ) {
-			frag += std::string(&line[first],last - first);
-		} else {
-			std::string tokval;
-			if( !frag.empty() ) {
-				tokval = frag + std::string(&line[first],last - first);
-				frag = "";
-			} else {
-				tokval = std::string(&line[first],last - first);
-			}
-			switch( token ) {
-			case tero::errFilename:
-				record = ( filename == boost::filesystem::path(tokval) );
-				break;;
-			case tero::errLineNum:
-				if( record ) {				
-					lineNum = atoi(tokval.c_str());					
-				}
-				break;
-			case tero::errMessage:
-				if( record ) {
-					annotations[lineNum] += tokval;
-				}
-				break;
-			default:
-                /* Nothing to do excepts shutup gcc warnings. */
-                break;
-			}
-		}
+    return p == last;
+}
+
+
+/** Words of a license text that follow the copyright holder,
+    along with their rolling hash. */
+class licenseFingerprint {
+public:
+    wordList words;
+
+    /* hash of *words* */
+    size_t hash;
+
+    /* wordBase raised to the number of *words* */
+    size_t power;
+
+    explicit licenseFingerprint( const char *text )
+        : hash(0), power(1) {
+        splitWords(words, text, text + strlen(text));
+        for( wordList::const_iterator w = words.begin();
+             w != words.end(); ++w ) {
+            hash = hash * wordBase + hashWord(w->begin(), w->end());
+            power *= wordBase;
+        }
     }
 };
 
+
 }; // anonymous
 
 
@@ -103,106 +150,131 @@ const char *licenseCodeTitles[] = {
 
 
 void checker::cache() {
-
-    static const boost::regex licenses_regex[] = {
+    /* Only the words following the copyright holder are fingerprinted,
+       such that the dates and grantor fields do not take part in
+       the match. */
+    static const licenseFingerprint fingerprints[] = {
         // MIT license
         // -----------
-boost::regex(
-"\\s*Copyright \\(c\\) (\\d+(?:-\\d+)?), ([^#]*)"
-" Permission is hereby granted, free of charge, to any person obtaining a copy"
-" of this software and associated documentation files \\(the \"Software\"\\),"
+        licenseFingerprint(
+"Permission is hereby granted, free of charge, to any person obtaining a copy"
+" of this software and associated documentation files (the \"Software\"),"
 " to deal in the Software without restriction, including without limitation"
 " the rights to use, copy, modify, merge, publish, distribute, sublicense,"
 " and/or sell copies of the Software, and to permit persons to whom the"
 " Software is furnished to do so, subject to the following conditions:"
 " The above copyright notice and this permission notice shall be included in"
-" all copies or substantial portions of the Software\\."
+" all copies or substantial portions of the Software."
 " THE SOFTWARE IS PROVIDED \"AS IS\", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR"
 " IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,"
-" FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT\\. IN NO EVENT SHALL THE"
+" FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE"
 " AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER"
 " LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,"
 " OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN"
-" THE SOFTWARE\\.\\s*"),
+" THE SOFTWARE."),
 
         // BSD 2-Clause
         // ------------
-        boost::regex(
-"\\s*Copyright \\(c\\) (\\d+(?:-\\d+)?), ([^#]*)"
-" All rights reserved\\."
+        licenseFingerprint(
+"All rights reserved."
 " Redistribution and use in source and binary forms, with or without"
 " modification, are permitted provided that the following conditions are met:"
-" 1\\. Redistributions of source code must retain the above copyright notice,"
-" this list of conditions and the following disclaimer\\."
-" 2\\. Redistributions in binary form must reproduce the above copyright"
+" 1. Redistributions of source code must retain the above copyright notice,"
+" this list of conditions and the following disclaimer."
+" 2. Redistributions in binary form must reproduce the above copyright"
 " notice, this list of conditions and the following disclaimer in the"
-" documentation and/or other materials provided with the distribution\\."
+" documentation and/or other materials provided with the distribution."
 " THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS"
 " \"AS IS\" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED"
 " TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR"
-" PURPOSE ARE DISCLAIMED\\. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR"
+" PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR"
 " CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,"
-" EXEMPLARY, OR CONSEQUENTIAL DAMAGES \\(INCLUDING, BUT NOT LIMITED TO,"
+" EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,"
 " PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;"
-" OR BUSINESS INTERRUPTION\\) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,"
-" WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT \\(INCLUDING NEGLIGENCE OR"
-" OTHERWISE\\) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF"
-" ADVISED OF THE POSSIBILITY OF SUCH DAMAGE\\.\\s*"),
+" OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,"
+" WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR"
+" OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF"
+" ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."),
 
         // BSD 3-Clause
         // ------------
-        boost::regex(
-"\\s*Copyright \\(c\\) (\\d+(?:-\\d+)?), ([^#]*)"
-" All rights reserved\\."
+        licenseFingerprint(
+"All rights reserved."
 " Redistribution and use in source and binary forms, with or without"
 " modification, are permitted provided that the following conditions are met:"
-" 1\\. Redistributions of source code must retain the above copyright notice,"
-" this list of conditions and the following disclaimer\\."
-" 2\\. Redistributions in binary form must reproduce the above copyright"
+" 1. Redistributions of source code must retain the above copyright notice,"
+" this list of conditions and the following disclaimer."
+" 2. Redistributions in binary form must reproduce the above copyright"
 " notice, this list of conditions and the following disclaimer in the"
-" documentation and/or other materials provided with the distribution\\."
-" 3\\. Neither the name of the copyright holder nor the names of its"
+" documentation and/or other materials provided with the distribution."
+" 3. Neither the name of the copyright holder nor the names of its"
 " contributors may be used to endorse or promote products derived from this"
-" software without specific prior written permission\\."
+" software without specific prior written permission."
 " THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS \"AS IS\""
 " AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE"
 " IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE"
-" ARE DISCLAIMED\\. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE"
+" ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE"
 " LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR"
-" CONSEQUENTIAL DAMAGES \\(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF"
+" CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF"
 " SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS"
-" INTERRUPTION\\) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN"
-" CONTRACT, STRICT LIABILITY, OR TORT \\(INCLUDING NEGLIGENCE OR OTHERWISE\\)"
+" INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN"
+" CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)"
 " ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE"
-" POSSIBILITY OF SUCH DAMAGE\\.\\s*"),
+" POSSIBILITY OF SUCH DAMAGE."),
 
         // Proprietary
         // -----------
-        boost::regex(
-"\\s*Copyright \\(c\\) (\\d+(?:-\\d+)?), ([^#]*)"
-" All rights reserved\\.\\s*"),
+        licenseFingerprint("All rights reserved.")
     };
 
-    boost::smatch m;
+    cached = true;
     std::string text = licenseText.str();
-    for( int license = MITLicense; license < 5; ++license ) {
-        if( boost::regex_match(text, m, licenses_regex[license - 1]) ) {
-            licenseType = (licenseCode)license;
-            dates = m.str(1);
-            grantor = m.str(2);
-            break;
+    wordList words;
+    splitWords(words, text.data(), text.data() + text.size());
+
+    /* Copyright (c) *dates*, *grantor* *body* */
+    if( words.size() < 4
+        || !sameWord(words[0], "Copyright") || !sameWord(words[1], "(c)")
+        || !isDates(words[2]) ) return;
+
+    std::vector<size_t> prefix(words.size() + 1, 0);
+    for( size_t i = 0; i < words.size(); ++i ) {
+        prefix[i + 1] = prefix[i] * wordBase
+            + hashWord(words[i].begin(), words[i].end());
+    }
+
+    const size_t n = words.size();
+    for( int license = MITLicense; license <= ProprietaryLicense; ++license ) {
+        const licenseFingerprint& body = fingerprints[license - 1];
+        /* at least one word is left for the grantor. */
+        if( body.words.size() + 4 > n ) continue;
+        size_t bodyStart = n - body.words.size();
+        if( prefix[n] - prefix[bodyStart] * body.power != body.hash
+            || !std::equal(body.words.begin(), body.words.end(),
+                &words[bodyStart], sameSlice) ) continue;
+
+        std::string holder;
+        for( size_t i = 3; i < bodyStart; ++i ) {
+            if( i > 3 ) holder += ' ';
+            holder.append(words[i].begin(), words[i].end());
         }
+        if( holder.find('#') != std::string::npos ) continue;
+
+        licenseType = (licenseCode)license;
+        dates.assign(words[2].begin(), words[2].end() - 1);
+        grantor = holder;
+        break;
     }
-    cached = true;
 }
 
 
 void checker::normalize( const char *line, int first, int last )
 {
-    std::string s(&line[first], &line[last]);
     if( state == start ) {
-        boost::smatch m;
-        if( !boost::regex_search(s, m, boost::regex("Copyright")) ) return;
+        static const char copyright[] = "Copyright";
+        if( std::search(&line[first], &line[last],
+                copyright, copyright + sizeof(copyright) - 1)
+            == &line[last] ) return;
         state = readLicense;
     }
     while( first < last ) {
@@ -313,6 +385,132 @@ void shChecker::token( shToken token, const char *line,
 }
 
 
+checkPool *checkPool::current = NULL;
+
+
+checkPool::checkPool( session& ps, size_t nbWorkers, size_t b )
+    : s(ps), budget(b), inflight(0), stopping(false)
+{
+    for( size_t i = 0; i < std::max(nbWorkers, (size_t)1); ++i ) {
+        workers.create_thread(boost::bind(&checkPool::work, this));
+    }
+    current = this;
+}
+
+
+checkPool::~checkPool()
+{
+    current = NULL;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    workers.join_all();
+    for( jobQueue::iterator j = submitted.begin(); j != submitted.end(); ++j ) {
+        delete (*j)->check;
+        delete *j;
+    }
+}
+
+
+void checkPool::work()
+{
+    for( ; ; ) {
+        job *j;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while( pending.empty() && !stopping ) ready.wait(lock);
+            if( pending.empty() ) return;
+            j = pending.front();
+            pending.pop_front();
+        }
+        try {
+            j->check->tokenize(&j->text[0], j->text.size() - 1);
+            j->check->license();
+        } catch( const std::exception& e ) {
+            j->error = e.what();
+        }
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            j->done = true;
+        }
+        checked.notify_all();
+    }
+}
+
+
+void checkPool::writeRows( size_t maxInflight )
+{
+    boost::mutex::scoped_lock lock(mutex);
+    while( !submitted.empty() ) {
+        job *j = submitted.front();
+        if( !j->done ) {
+            if( inflight <= maxInflight ) break;
+            checked.wait(lock);
+            continue;
+        }
+        submitted.pop_front();
+        inflight -= j->text.size();
+        lock.unlock();
+        std::auto_ptr<checker> check(j->check);
+        std::auto_ptr<job> done(j);
+        if( !j->error.empty() ) {
+            boost::throw_exception(std::runtime_error(j->error));
+        }
+        checkfileRow(s, *j->check, j->name);
+        lock.lock();
+    }
+}
+
+
+void checkPool::submit( checker *check, const slice<char>& text,
+    const url& name )
+{
+    std::auto_ptr<job> j(new job);
+    j->check = check;
+    j->text.reserve(text.size() + 1);
+    j->text.assign(text.begin(), text.end());
+    /* The tokenizers read one character past the text. */
+    j->text.push_back('\0');
+    j->name = name;
+    j->done = false;
+
+    /* Waits for enough memory to be released. A single text
+       larger than the budget is checked on its own. */
+    writeRows(budget > j->text.size() ? budget - j->text.size() : 0);
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        inflight += j->text.size();
+        submitted.push_back(j.get());
+        pending.push_back(j.release());
+    }
+    ready.notify_one();
+}
+
+
+void checkfileRow( session& s, checker& check, const url& name )
+{
+    using namespace boost::filesystem;
+
+    path pathname = s.abspath(name);
+    revisionsys *rev = revisionsys::findRev(s, pathname);
+    path filename = rev ? rev->relative(pathname) : name.pathname;
+
+    s.out() << html::tr()
+            << html::td() << html::a().href(name)
+            << filename << html::a::end << html::td::end
+            << html::td() << check.license();
+    if( !check.grantor.empty() ) {
+        s.out() << " (" << check.dates << "," << check.grantor << ")";
+    }
+    s.out() << html::td::end
+            << html::td() << check.nbCodeLines << html::td::end
+            << html::td() << check.nbLines << html::td::end
+            << html::tr::end;
+}
+
+
 void checkstyle::addDir( session& s,
     const boost::filesystem::path& pathname ) const {
 }
@@ -338,6 +536,7 @@ void checkstyle::addFile( session& s,
 
 void checkstyle::flush( session& s ) const
 {
+    if( checkPool::current != NULL ) checkPool::current->flush();
     if( state != start ) {
         s.out() << html::table::end
                 << html::p::end;
@@ -347,40 +546,202 @@ void checkstyle::flush( session& s ) const
 
 void checkstyleFetch( session& s, const url& name )
 {
+    /* Source files are loaded by this thread while they are checked
+       by workers, keeping at most 16MB of text in flight. Pages might
+       be generated by *jobs* processes at once so by default they
+       share the processors. */
+    int maxThreads = std::max((int)boost::thread::hardware_concurrency(), 1);
+    int nbThreads = maxThreads;
+    session::variables::const_iterator look = s.find(checkThreads.name);
+    if( s.found(look) ) {
+        nbThreads = checkThreads.value(s);
+    } else {
+        look = s.find(jobs.name);
+        if( s.found(look) && jobs.value(s) > 1 ) {
+            nbThreads = maxThreads / jobs.value(s);
+        }
+    }
+    checkPool pool(s, std::min(std::max(nbThreads, 1), maxThreads),
+        16 * 1024 * 1024);
     checkstyle p;
     p.fetch(s,s.abspath(name));
 }
 
 
-void lintAnnotate::init( session& s,
-						 const boost::filesystem::path& key,
-						 std::istream& info )
+/** Records the location of messages in a log as the log is tokenized.
+ */
+class lintIndexer : public errTokListener {
+protected:
+    typedef std::map<std::string,size_t> fileIdMap;
+
+    lintIndex& index;
+    fileIdMap fileIds;
+    const char *fileFirst;
+    const char *fileLast;
+    size_t file;
+    bool record;
+    int lineNum;
+
+public:
+    explicit lintIndexer( lintIndex& i )
+        : index(i), fileFirst(NULL), fileLast(NULL),
+          file(0), record(false), lineNum(0) {}
+
+    void newline( const char *line, int first, int last ) {
+    }
+
+    void token( errToken token, const char *line,
+        int first, int last, bool fragment ) {
+        /* The whole log is tokenized in a single call so a fragment
+           can only be the last token of an unterminated line. */
+        switch( token ) {
+        case errFilename:
+            /* Consecutive messages are most often about the same file. */
+            if( fileFirst == NULL
+                || (size_t)(fileLast - fileFirst) != (size_t)(last - first)
+                || memcmp(fileFirst, &line[first], last - first) != 0 ) {
+                fileIdMap::const_iterator found = fileIds.insert(
+                    std::make_pair(std::string(&line[first], &line[last]),
+                        fileIds.size())).first;
+                file = found->second;
+                fileFirst = &line[first];
+                fileLast = &line[last];
+            }
+            record = true;
+            break;
+        case errLineNum:
+            lineNum = 0;
+            for( int i = first; i < last && isdigit(line[i]); ++i ) {
+                lineNum = lineNum * 10 + (line[i] - '0');
+            }
+            break;
+        case errMessage:
+            if( record ) {
+                lintIndex::note n;
+                n.file = file;
+                n.line = lineNum;
+                n.first = first;
+                n.last = last;
+                index.notes.push_back(n);
+            }
+            break;
+        default:
+            /* Nothing to do excepts shutup gcc warnings. */
+            break;
+        }
+    }
+
+    /** Groups the notes by file, keeping the order of the log
+        for the notes about the same file. */
+    void flush() {
+        std::stable_sort(index.notes.begin(), index.notes.end(),
+            lintIndex::fileLess);
+        lintIndex::note key;
+        for( fileIdMap::const_iterator f = fileIds.begin();
+             f != fileIds.end(); ++f ) {
+            key.file = f->second;
+            std::pair<lintIndex::noteList::iterator,
+                      lintIndex::noteList::iterator> range
+                = std::equal_range(index.notes.begin(), index.notes.end(),
+                    key, lintIndex::fileLess);
+            if( range.first != range.second ) {
+                index.files[f->first] = std::make_pair(
+                    (size_t)(range.first - index.notes.begin()),
+                    (size_t)(range.second - index.notes.begin()));
+            }
+        }
+    }
+};
+
+
+lintIndex::lintIndex( std::istream& log )
+    : mtime(0)
+{
+    char buffer[4096];
+    while( !log.eof() ) {
+        log.read(buffer,4096);
+        text.insert(text.end(), buffer, buffer + log.gcount());
+    }
+    size_t n = text.size();
+    /* The tokenizer looks one character past the end of the text. */
+    text.push_back('\0');
+
+    lintIndexer indexer(*this);
+    errTokenizer tok(indexer);
+    tok.tokenize(&text[0], n);
+    indexer.flush();
+}
+
+
+lintIndex::pointer_type
+lintIndex::find( const boost::filesystem::path& pathname )
 {
-	errTokWriter w(super::annotations,key);
-	errTokenizer tok(w);
-	
-	char buffer[4096];
-	while( !info.eof() ) {
-		info.read(buffer,4096);
-		tok.tokenize(buffer,info.gcount());
-	}
+    /* log path -> (index, last use) */
+    typedef std::map<std::string,
+        std::pair<pointer_type,unsigned long> > indexMap;
+    enum { maxIndices = 8 };
+    static indexMap indices;
+    static unsigned long uses = 0;
+
+    boost::system::error_code ec;
+    std::time_t lwt = boost::filesystem::last_write_time(pathname, ec);
+    if( ec ) return pointer_type();
+
+    indexMap::iterator found = indices.find(pathname.string());
+    if( found != indices.end() && found->second.first->mtime == lwt ) {
+        found->second.second = ++uses;
+        return found->second.first;
+    }
+    boost::filesystem::ifstream log(pathname);
+    if( log.fail() ) return pointer_type();
+    lintIndex *index = new lintIndex(log);
+    index->mtime = lwt;
+    pointer_type result(index);
+    if( found == indices.end() && indices.size() >= maxIndices ) {
+        /* Evicts the least recently used index. */
+        indexMap::iterator oldest = indices.begin();
+        for( indexMap::iterator i = indices.begin(); i != indices.end(); ++i ) {
+            if( i->second.second < oldest->second.second ) oldest = i;
+        }
+        indices.erase(oldest);
+    }
+    indices[pathname.string()] = std::make_pair(result, ++uses);
+    return result;
 }
 
 
-lintAnnotate::lintAnnotate( session& s,
-							const boost::filesystem::path& key,
-							std::istream& info ) 
-	: super() { 
-	init(s,key,info);
+void lintIndex::annotations( std::map<int,std::string>& annotations,
+    const boost::filesystem::path& key ) const
+{
+    fileMap::const_iterator found = files.find(key.string());
+    if( found == files.end() ) return;
+    for( size_t i = found->second.first; i < found->second.second; ++i ) {
+        const note& n = notes[i];
+        annotations[n.line].append(&text[n.first], &text[n.last]);
+    }
 }
 
-    
-lintAnnotate::lintAnnotate( session& s,
-							const boost::filesystem::path& key,
-							std::istream& info,
+
+void lintAnnotate::init( const boost::filesystem::path& key,
+						 const boost::filesystem::path& logPath )
+{
+	lintIndex::pointer_type index = lintIndex::find(logPath);
+	if( index ) index->annotations(super::annotations,key);
+}
+
+
+lintAnnotate::lintAnnotate( const boost::filesystem::path& key,
+							const boost::filesystem::path& logPath )
+	: super() {
+	init(key,logPath);
+}
+
+
+lintAnnotate::lintAnnotate( const boost::filesystem::path& key,
+							const boost::filesystem::path& logPath,
 							std::basic_ostream<char>& o )
 	: super(o) {
-	init(s,key,info);
+	init(key,logPath);
 }
 
 }
@@ -0,0 +1,402 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include "commitlog.hh"
+
+/** Index of the commits in a git repository.
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace {
+
+const char *indexMagic = "semilla-log 1";
+
+/** Orders commits by decreasing time. */
+bool newerThan( const tero::commitLog::entry& left,
+    const tero::commitLog::entry& right ) {
+    return left.time > right.time;
+}
+
+}
+
+
+namespace tero {
+
+std::string commitLog::entry::title() const {
+    return message.substr(0, message.find('\n'));
+}
+
+
+bool commitLog::parseCommit( const gitObjects::buffer& data, entry& commit,
+    std::string& tree, std::vector<std::string>& parents ) const
+{
+    std::string text(data.begin(), data.end());
+    size_t first = 0;
+    while( first < text.size() ) {
+        size_t last = text.find('\n', first);
+        if( last == std::string::npos ) last = text.size();
+        if( last == first ) {
+            /* blank line separates headers from the message. */
+            commit.message = text.substr(last + 1);
+            while( !commit.message.empty()
+                && commit.message[commit.message.size() - 1] == '\n' ) {
+                commit.message.erase(commit.message.size() - 1);
+            }
+            break;
+        }
+        std::string line = text.substr(first, last - first);
+        if( line.compare(0, 5, "tree ") == 0 ) {
+            tree = line.substr(5);
+        } else if( line.compare(0, 7, "parent ") == 0 ) {
+            parents.push_back(line.substr(7));
+        } else if( line.compare(0, 7, "author ") == 0 ) {
+            /* "author First Last <email> seconds timezone" */
+            size_t estart = line.find('<');
+            size_t efinish = line.rfind('>');
+            if( estart == std::string::npos || efinish < estart ) {
+                return false;
+            }
+            size_t nameLast = estart;
+            while( nameLast > 7 && line[nameLast - 1] == ' ' ) --nameLast;
+            commit.authorName = line.substr(7, nameLast - 7);
+            commit.authorEmail = line.substr(estart + 1, efinish - estart - 1);
+            commit.time = strtoll(line.c_str() + efinish + 1, NULL, 10);
+        }
+        first = last + 1;
+    }
+    return !tree.empty();
+}
+
+
+void commitLog::diffTrees( gitObjects& objects, const std::string& prefix,
+    const gitObjects::objectId& left, const gitObjects::objectId& right,
+    std::set<std::string>& changed, bool dirs ) const
+{
+    typedef std::map<std::string,gitObjects::treeEntry> entryMap;
+
+    entryMap sides[2];
+    const gitObjects::objectId *ids[2] = { &left, &right };
+    for( int side = 0; side < 2; ++side ) {
+        gitObjects::buffer data;
+        if( ids[side]->empty()
+            || objects.read(*ids[side], data) != gitObjects::treeObj ) {
+            continue;
+        }
+        gitObjects::treeEntries entries;
+        gitObjects::parseTree(data, entries);
+        for( gitObjects::treeEntries::const_iterator
+                 e = entries.begin(); e != entries.end(); ++e ) {
+            sides[side][e->name] = *e;
+        }
+    }
+
+    std::set<std::string> names;
+    for( int side = 0; side < 2; ++side ) {
+        for( entryMap::const_iterator e = sides[side].begin();
+             e != sides[side].end(); ++e ) {
+            names.insert(e->first);
+        }
+    }
+    static const gitObjects::objectId absent;
+    for( std::set<std::string>::const_iterator name = names.begin();
+         name != names.end(); ++name ) {
+        entryMap::const_iterator l = sides[0].find(*name);
+        entryMap::const_iterator r = sides[1].find(*name);
+        bool hasLeft = (l != sides[0].end());
+        bool hasRight = (r != sides[1].end());
+        if( hasLeft && hasRight && l->second.id == r->second.id
+            && l->second.mode == r->second.mode ) continue;
+
+        bool leftTree = hasLeft && l->second.isTree();
+        bool rightTree = hasRight && r->second.isTree();
+        if( leftTree || rightTree ) {
+            if( dirs ) changed.insert(prefix + *name + "/");
+            diffTrees(objects, prefix + *name + "/",
+                leftTree ? l->second.id : absent,
+                rightTree ? r->second.id : absent, changed, dirs);
+        }
+        if( (hasLeft && !leftTree) || (hasRight && !rightTree) ) {
+            changed.insert(prefix + *name);
+        }
+    }
+}
+
+
+bool commitLog::update( gitObjects& objects, bool& changed )
+{
+    changed = false;
+    gitObjects::objectId headId;
+    if( !objects.resolve("HEAD", headId) ) return false;
+    std::string headHex = gitObjects::hex(headId);
+    if( headHex == head ) return true;
+
+    std::set<std::string> known;
+    for( entrySet::const_iterator c = commits.begin(); c != commits.end(); ++c ) {
+        known.insert(c->id);
+    }
+
+    /* Walk back from HEAD until we reach commits already indexed. */
+    entrySet added;
+    std::map<std::string,std::string> trees;
+    std::set<std::string> visited;
+    std::vector<std::string> stack(1, headHex);
+    bool reachedHead = head.empty();
+    while( !stack.empty() ) {
+        std::string id = stack.back();
+        stack.pop_back();
+        if( id == head ) reachedHead = true;
+        if( known.find(id) != known.end()
+            || !visited.insert(id).second ) continue;
+
+        gitObjects::objectId binId;
+        gitObjects::buffer data;
+        if( !gitObjects::unhex(id, binId)
+            || objects.read(binId, data) != gitObjects::commitObj ) {
+            return false;
+        }
+        entry commit;
+        commit.id = id;
+        std::string tree;
+        std::vector<std::string> parents;
+        if( !parseCommit(data, commit, tree, parents) ) return false;
+
+        /* Files touched are the ones that differ from the parent.
+           As git log does, a merge only touches the paths that differ
+           from all its parents. Since a directory can differ from all
+           parents while each of its files is the same as in one parent,
+           directories (with a trailing '/') are recorded for merges. */
+        gitObjects::objectId treeId;
+        gitObjects::unhex(tree, treeId);
+        std::set<std::string> paths;
+        if( parents.empty() ) {
+            diffTrees(objects, "", gitObjects::objectId(), treeId, paths, false);
+        }
+        for( std::vector<std::string>::const_iterator
+                 parent = parents.begin(); parent != parents.end(); ++parent ) {
+            std::map<std::string,std::string>::const_iterator
+                found = trees.find(*parent);
+            std::string parentTree;
+            if( found != trees.end() ) {
+                parentTree = found->second;
+            } else {
+                gitObjects::objectId parentId;
+                gitObjects::buffer parentData;
+                entry parentCommit;
+                std::vector<std::string> grandParents;
+                if( !gitObjects::unhex(*parent, parentId)
+                    || objects.read(parentId, parentData)
+                    != gitObjects::commitObj
+                    || !parseCommit(parentData, parentCommit,
+                        parentTree, grandParents) ) {
+                    return false;
+                }
+                trees[*parent] = parentTree;
+            }
+            gitObjects::objectId parentTreeId;
+            gitObjects::unhex(parentTree, parentTreeId);
+            std::set<std::string> diffs;
+            diffTrees(objects, "", parentTreeId, treeId, diffs,
+                parents.size() > 1);
+            if( parent == parents.begin() ) {
+                paths.swap(diffs);
+            } else {
+                std::set<std::string> common;
+                std::set_intersection(paths.begin(), paths.end(),
+                    diffs.begin(), diffs.end(),
+                    std::inserter(common, common.begin()));
+                paths.swap(common);
+            }
+            stack.push_back(*parent);
+        }
+        commit.paths.assign(paths.begin(), paths.end());
+        trees[id] = tree;
+        added.push_back(commit);
+    }
+
+    if( !reachedHead ) {
+        /* History was rewritten, index everything again. */
+        head.clear();
+        commits.clear();
+        byPath.clear();
+        return update(objects, changed);
+    }
+
+    std::stable_sort(added.begin(), added.end(), newerThan);
+    entrySet merged;
+    merged.reserve(added.size() + commits.size());
+    std::merge(added.begin(), added.end(), commits.begin(), commits.end(),
+        std::back_inserter(merged), newerThan);
+    commits.swap(merged);
+    head = headHex;
+    reindex();
+    changed = true;
+    return true;
+}
+
+
+void commitLog::reindex() {
+    byPath.clear();
+    for( size_t i = 0; i < commits.size(); ++i ) {
+        for( std::vector<std::string>::const_iterator
+                 p = commits[i].paths.begin(); p != commits[i].paths.end(); ++p ) {
+            byPath[*p].push_back(i);
+        }
+    }
+}
+
+
+void commitLog::history( const std::string& pathname,
+    entryRefs& results ) const
+{
+    if( pathname.empty() ) {
+        for( entrySet::const_iterator c = commits.begin();
+             c != commits.end(); ++c ) {
+            results.push_back(&*c);
+        }
+        return;
+    }
+
+    std::set<size_t> found;
+    pathIndex::const_iterator file = byPath.find(pathname);
+    if( file != byPath.end() ) {
+        found.insert(file->second.begin(), file->second.end());
+    }
+    std::string dirname = pathname + "/";
+    for( pathIndex::const_iterator p = byPath.lower_bound(dirname);
+         p != byPath.end() && p->first.compare(0, dirname.size(), dirname) == 0;
+         ++p ) {
+        found.insert(p->second.begin(), p->second.end());
+    }
+    for( std::set<size_t>::const_iterator i = found.begin();
+         i != found.end(); ++i ) {
+        results.push_back(&commits[*i]);
+    }
+}
+
+
+bool commitLog::load( const boost::filesystem::path& pathname )
+{
+    boost::filesystem::ifstream file(pathname);
+    std::string line;
+    if( !std::getline(file, line) || line != indexMagic ) return false;
+
+    head.clear();
+    commits.clear();
+    entry *commit = NULL;
+    bool complete = false;
+    while( std::getline(file, line) ) {
+        size_t sep = line.find(' ');
+        std::string key = line.substr(0, sep);
+        std::string value
+            = (sep == std::string::npos) ? std::string() : line.substr(sep + 1);
+        if( key == "head" ) {
+            head = value;
+        } else if( key == "commit" ) {
+            commits.push_back(entry());
+            commit = &commits.back();
+            size_t timeSep = value.find(' ');
+            commit->id = value.substr(0, timeSep);
+            if( timeSep != std::string::npos ) {
+                commit->time = strtoll(value.c_str() + timeSep + 1, NULL, 10);
+            }
+        } else if( key == "eof" ) {
+            complete = true;
+        } else if( commit ) {
+            if( key == "author" ) {
+                commit->authorName = value;
+            } else if( key == "email" ) {
+                commit->authorEmail = value;
+            } else if( key == "path" ) {
+                commit->paths.push_back(value);
+            } else if( key == "message" ) {
+                if( !commit->message.empty() ) commit->message += '\n';
+                commit->message += value;
+            }
+        }
+    }
+    if( !complete ) {
+        /* truncated index, it will be built again. */
+        head.clear();
+        commits.clear();
+    }
+    reindex();
+    return complete;
+}
+
+
+bool commitLog::save( const boost::filesystem::path& pathname ) const
+{
+    using namespace boost::filesystem;
+
+    boost::system::error_code err;
+    create_directories(pathname.parent_path(), err);
+    if( err ) return false;
+
+    /* write a temporary file and rename it such that concurrent readers
+       never see a partial index. */
+    std::stringstream tmpname;
+    tmpname << pathname.string() << "." << getpid();
+    {
+        ofstream file(tmpname.str());
+        if( !file ) return false;
+        file << indexMagic << '\n';
+        file << "head " << head << '\n';
+        for( entrySet::const_iterator c = commits.begin();
+             c != commits.end(); ++c ) {
+            file << "commit " << c->id << ' ' << c->time << '\n';
+            file << "author " << c->authorName << '\n';
+            file << "email " << c->authorEmail << '\n';
+            std::istringstream message(c->message);
+            std::string line;
+            while( std::getline(message, line) ) {
+                file << "message " << line << '\n';
+            }
+            for( std::vector<std::string>::const_iterator
+                     p = c->paths.begin(); p != c->paths.end(); ++p ) {
+                file << "path " << *p << '\n';
+            }
+        }
+        file << "eof\n";
+        if( !file ) {
+            file.close();
+            boost::system::error_code ec;
+            remove(tmpname.str(), ec);
+            return false;
+        }
+    }
+    boost::system::error_code ec;
+    rename(tmpname.str(), pathname, ec);
+    return !ec;
+}
+
+}
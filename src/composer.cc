@@ -23,7 +23,10 @@
    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <boost/regex.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include "composer.hh"
@@ -35,83 +38,183 @@
 
 namespace tero {
 
-class composerListener : public xmlTokListener {
+/** Records the tokens of a template file such that it can be compiled
+    for different sets of widgets without being tokenized again.
+*/
+class templateRecorder : public xmlTokListener {
+public:
+    struct event {
+        /* a newline is recorded as an xmlErr token with no text. */
+        bool newline;
+        xmlToken token;
+        std::string text;
+    };
+
+    typedef std::vector<event> eventList;
+
+    eventList events;
+
+    virtual void newline( const char *line, int first, int last ) {
+        event e;
+        e.newline = true;
+        e.token = xmlErr;
+        events.push_back(e);
+    }
+
+    virtual void token( xmlToken token, const char *line,
+        int first, int last, bool fragment ) {
+        event e;
+        e.newline = false;
+        e.token = token;
+        e.text.assign(&line[first], last - first);
+        events.push_back(e);
+    }
+};
+
+
+/** A template file compiled into runs of static text and widget slots.
+
+    Which elements are replaced by the output of a widget depends on
+    the document being composed. Out of the class attribute values
+    that can name a widget (*candidates*), the ones which select an entry
+    for the document make up a signature. A program is compiled
+    (and kept) for each signature seen so far.
+*/
+class composedTemplate {
+public:
+    /** Writes *text* then invokes the fetch for *widget*, if not empty. */
+    struct step {
+        std::string text;
+        std::string widget;
+    };
+
+    typedef std::vector<step> program;
+
+    typedef std::vector<bool> signature;
+
 protected:
-    session& s;
-    size_t elementDepth;
-    size_t replaceDepth;
-    enum {
-        composeInitial = 0,
-        composeElemStart,
-        composeClassStart,
-        composeInComposition,
-    } state;
-
-    std::stringstream buffer;
-
-#if 0
-    void fetchAndReplace( session& s ) {
-        std::ostream& prevDisp = s.out();
-        try {
-            path prev = current_path();
-            current_path(s.prefixdir(fixed));
-            dispatchDoc::instance()->fetch(s,widget,url(value));
-            current_path(prev);
-        } catch( const std::runtime_error& e ) {
-            s.out(prevDisp);
-            s.feeds = NULL; /* ok here since those objects were
-                               allocated on the stack. */
-            ++s.nErrs;
-            std::cerr << "[embed of '" << value << "'] "
-                      << e.what() << std::endl;
-            s.out() << "<p>" << e.what() << "</p>" << std::endl;
-        }
+    templateRecorder::eventList events;
+
+    std::vector<std::string> candidates;
+
+    std::map<signature,program> programs;
+
+    static bool isClassName( const std::string& name ) {
+        return strncmp(name.c_str(), "class", name.size()) == 0;
+    }
+
+    static std::string attValue( const std::string& text ) {
+        return text.size() >= 2 ? text.substr(1, text.size() - 2)
+            : std::string();
     }
-#endif
+
+    void compile( program& prog, const signature& selected ) const;
 
 public:
-    explicit composerListener( session& ps )
-        : s(ps), elementDepth(0), replaceDepth(0), state(composeInitial) {}
+    /** Validates the cached template against the theme file. */
+    std::string stamp;
 
-    virtual void newline( const char *line, int first, int last ) {
-        static const char *endofline = "\n";
-        if( state == composeInitial ) {
-            // flush buffer
-            buffer.write(endofline, 1);
-            s.out() << buffer.str();
-            buffer.str("");
-        } else if( state != composeInComposition ) {
-            buffer.write(endofline, 1);
+    explicit composedTemplate( std::istream& strm );
+
+    void run( session& s );
+};
+
+
+composedTemplate::composedTemplate( std::istream& strm )
+{
+    templateRecorder recorder;
+    xmlTokenizer tokenizer(recorder);
+
+    std::string line;
+    std::getline(strm, line);
+    while( !strm.eof() ) {
+        tokenizer.tokenize(line.c_str(), line.size());
+        recorder.newline(NULL, 0, 0);
+        std::getline(strm, line);
+    }
+    events.swap(recorder.events);
+
+    /* An attribute value is looked up as a widget only after
+       a class attribute name in the same element. */
+    bool afterClass = false;
+    for( templateRecorder::eventList::const_iterator e = events.begin();
+         e != events.end(); ++e ) {
+        if( e->newline ) continue;
+        switch( e->token ) {
+        case xmlElementStart:
+        case xmlCloseTag:
+            afterClass = false;
+            break;
+        case xmlName:
+            if( isClassName(e->text) ) afterClass = true;
+            break;
+        case xmlAttValue:
+            if( afterClass ) {
+                std::string att = attValue(e->text);
+                if( std::find(candidates.begin(), candidates.end(), att)
+                    == candidates.end() ) {
+                    candidates.push_back(att);
+                }
+            }
+            break;
+        default:
+            break;
         }
     }
+}
 
-    virtual void token( xmlToken token, const char *line,
-        int first, int last, bool fragment ) {
-        switch( token ) {
+
+/** Compiles the template when the widgets in *selected* are the ones
+    matching the document. Elements are buffered until it is known
+    whether their class attribute names a widget, in which case
+    the buffered text is discarded and replaced by the widget.
+*/
+void composedTemplate::compile( program& prog, const signature& selected ) const
+{
+    size_t elementDepth = 0;
+    size_t replaceDepth = 0;
+    enum {
+        composeInitial = 0,
+        composeElemStart,
+        composeClassStart,
+        composeInComposition
+    } state = composeInitial;
+
+    std::string buffer;
+    step current;
+    for( templateRecorder::eventList::const_iterator e = events.begin();
+         e != events.end(); ++e ) {
+        if( e->newline ) {
+            if( state == composeInitial ) {
+                current.text += buffer;
+                current.text += '\n';
+                buffer.clear();
+            } else if( state != composeInComposition ) {
+                buffer += '\n';
+            }
+            continue;
+        }
+        switch( e->token ) {
         case xmlErr:
         case xmlAssign:
             break;
         case xmlAttValue:
             if( state == composeClassStart ) {
-                std::string att(&line[first + 1], last - first - 2);
-                const fetchEntry* entry = dispatchDoc::instance()->select(
-                    att, document.value(s).string());
-                if( entry ) {
-                    // XXX && with found a match
+                std::string att = attValue(e->text);
+                size_t index = std::find(candidates.begin(),
+                    candidates.end(), att) - candidates.begin();
+                if( index < candidates.size() && selected[index] ) {
                     replaceDepth = elementDepth - 1;
                     state = composeInComposition;
-#if 0
-                    std::cerr << "[found entry for " << att << " at depth "
-                              << replaceDepth << "]" << std::endl;
-#endif
-                    buffer.str("");
-                    dispatchDoc::instance()->fetch(s, att, document.value(s));
+                    buffer.clear();
+                    current.widget = att;
+                    prog.push_back(current);
+                    current = step();
                 }
             }
             break;
         case xmlCloseTag:
             if( state == composeElemStart || state == composeClassStart ) {
-                // no appropriate class, let's flush
                 state = composeInitial;
             }
             break;
@@ -123,24 +226,16 @@ public:
         case xmlElementEnd:
         case xmlEmptyElementEnd:
             if( elementDepth == replaceDepth ) {
-                // flushing
                 state = composeInitial;
-#if 0
-                std::cerr << "[restore after "
-                          << std::string(&line[first], last - first)
-                          << "at depth " << replaceDepth << "]"
-                          << std::endl;
-#endif
             }
             --elementDepth;
             break;
         case xmlElementStart:
-            // start buffering
             ++elementDepth;
             state = composeElemStart;
             break;
         case xmlName:
-            if( strncmp(&line[first], "class", last - first) == 0 ) {
+            if( isClassName(e->text) ) {
                 state = composeClassStart;
             }
             break;
@@ -148,16 +243,53 @@ public:
             break;
         }
         if( state == composeInitial ) {
-            // flush buffer
-            buffer.write(&line[first], last - first);
-            s.out() << buffer.str();
-            buffer.str("");
+            current.text += buffer;
+            current.text += e->text;
+            buffer.clear();
         } else if( state != composeInComposition ) {
-            // buffer
-            buffer.write(&line[first], last - first);
+            buffer += e->text;
         }
     }
-};
+    /* Text still buffered at the end of the template is dropped. */
+    if( !current.text.empty() ) prog.push_back(current);
+}
+
+
+void composedTemplate::run( session& s )
+{
+    dispatchDoc *docs = dispatchDoc::instance();
+    url doc = document.value(s);
+    signature selected;
+    selected.reserve(candidates.size());
+    for( std::vector<std::string>::const_iterator c = candidates.begin();
+         c != candidates.end(); ++c ) {
+        selected.push_back(docs->select(*c, doc.string()) != NULL);
+    }
+
+    std::map<signature,program>::iterator found = programs.find(selected);
+    if( found == programs.end() ) {
+        found = programs.insert(
+            std::make_pair(selected, program())).first;
+        compile(found->second, selected);
+    }
+
+    for( program::const_iterator p = found->second.begin();
+         p != found->second.end(); ++p ) {
+        s.out().write(p->text.data(), p->text.size());
+        if( !p->widget.empty() ) {
+            docs->fetch(s, p->widget, document.value(s));
+        }
+    }
+}
+
+
+namespace {
+
+typedef std::map<boost::filesystem::path,composedTemplate*> templateCache;
+
+templateCache templates;
+
+}
 
 
 pathVariable themeDir("themeDir",
@@ -185,19 +317,48 @@ composerAddSessionVars( boost::program_options::options_description& opts,
 void
 compose( session& s, std::istream& strm, const boost::filesystem::path& fixed )
 {
-    using namespace boost;
-    using namespace boost::system;
-    using namespace boost::filesystem;
+    composedTemplate compiled(strm);
+    compiled.run(s);
+}
 
-    composerListener cmpl(s);
-    xmlTokenizer tokenizer(cmpl);
 
-    std::string line;
-    std::getline(strm, line);
-    while( !strm.eof() ) {
-        tokenizer.tokenize(line.c_str(), line.size());
-        cmpl.newline(NULL, 0, 0);
-        std::getline(strm, line);
+void compose( session& s, const boost::filesystem::path& fixed )
+{
+    /* Templates are compiled once for each version of the theme file. */
+    std::string stamp = revisionsys::stamp(fixed);
+    if( stamp != "-" ) {
+        templateCache::iterator found = templates.find(fixed);
+        if( found != templates.end() && found->second->stamp == stamp ) {
+            s.depends(fixed);
+            found->second->run(s);
+            return;
+        }
+    }
+
+    std::streambuf *buf = revisionsys::findRevOpenfile(s, fixed);
+    if( buf ) {
+        std::istream strm(buf);
+        composedTemplate *compiled = new composedTemplate(strm);
+        delete buf;
+        if( stamp != "-" ) {
+            templateCache::iterator found = templates.find(fixed);
+            if( found != templates.end() ) {
+                delete found->second;
+                templates.erase(found);
+            }
+            compiled->stamp = stamp;
+            templates[fixed] = compiled;
+            compiled->run(s);
+        } else {
+            /* Themes stored only in a repository are not cached. */
+            try {
+                compiled->run(s);
+            } catch( ... ) {
+                delete compiled;
+                throw;
+            }
+            delete compiled;
+        }
     }
 }
 
@@ -23,7 +23,10 @@
    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <boost/date_time.hpp>
 #include <boost/system/error_code.hpp>
@@ -45,13 +48,53 @@ void contrib::normalize() {
     email = tero::normalize(email);
 }
 
+namespace {
+
+/* Contributors interned by normalized address. */
+typedef std::map<std::string,contrib::pointer_type> registryMap;
+registryMap registry;
+
+} // anonymous
+
+
 contrib::pointer_type contrib::find( const std::string& email,
     const std::string& name )
 {
-    pointer_type p(new contrib());
-    p->name = name;
-    p->email = email;
-    return p;
+    /* Addresses are compared case-insensitively, ignoring
+       surrounding whitespaces. */
+    std::string key = tero::strip(email);
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    if( key.empty() ) {
+        /* Without an address, there is nothing to identify
+           the contributor by. */
+        pointer_type p(new contrib());
+        p->name = name;
+        p->email = email;
+        return p;
+    }
+
+    registryMap::iterator found = registry.find(key);
+    if( found == registry.end() ) {
+        pointer_type p(new contrib());
+        p->name = name;
+        p->email = tero::strip(email);
+        found = registry.insert(std::make_pair(key, p)).first;
+    } else if( found->second->name.empty() ) {
+        found->second->name = name;
+    } else if( !name.empty() && name != found->second->name ) {
+        /* The display name differs from the one interned
+           for this address. It only applies to the caller's post. */
+        pointer_type p(new contrib(*found->second));
+        p->name = name;
+        return p;
+    }
+    return found->second;
+}
+
+
+void contrib::clear()
+{
+    registry.clear();
 }
 
 
@@ -27,23 +27,33 @@
 #include "document.hh"
 #include "changelist.hh"
 #include "decorator.hh"
+#include "checkstyle.hh"
+#include "shfiles.hh"
 
 namespace tero {
 
 void cppFetch( session& s, std::istream& in, const url& name )
 {
+    boost::filesystem::path key, log;
+    bool annotated = lintSource(s,s.abspath(name),key,log);
+
+    /* order of declaration is important here. */
+    lintAnnotate lint(key,log);
     linkLight leftLinkStrm(s, siteTop.value(s));
     linkLight rightLinkStrm(s, siteTop.value(s));
     cppLight leftCppStrm;
     cppLight rightCppStrm;
-    decoratorChain leftChain;
-    decoratorChain rightChain;
+    decoratorChain leftChain(true);
+    decoratorChain rightChain(true);
+    if( annotated && !lint.empty() ) {
+        leftChain.push_back(lint);
+    }
     leftChain.push_back(leftLinkStrm);
     leftChain.push_back(leftCppStrm);
     rightChain.push_back(rightLinkStrm);
     rightChain.push_back(rightCppStrm);
-    text cpp(leftChain,rightChain);
-    cpp.fetch(s,in);
+    text cpp(leftChain,rightChain,"link+cpp");
+    cpp.fetch(s,in,name);
 }
 
 
@@ -55,8 +65,8 @@ void cppDiff( session& s, const url& name )
     linkLight rightLinkStrm(s, siteTop.value(s));
     cppLight leftCppStrm;
     cppLight rightCppStrm;
-    decoratorChain leftChain;
-    decoratorChain rightChain;
+    decoratorChain leftChain(true);
+    decoratorChain rightChain(true);
     leftChain.push_back(leftLinkStrm);
     leftChain.push_back(leftCppStrm);
     rightChain.push_back(rightLinkStrm);
@@ -0,0 +1,309 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include <algorithm>
+#include <cstring>
+#include "diff.hh"
+
+/** Line-by-line differences between two texts.
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace {
+
+/* Past this number of edits, Myers' algorithm gives up on finding
+   the shortest alignment of a run and reports it as changed. */
+const int maxEdits = 4096;
+
+void splitLines( tero::textDiff::lineSet& lines,
+    const char *first, const char *last )
+{
+    lines.clear();
+    while( first != last ) {
+        const char *p = static_cast<const char*>(
+            memchr(first, '\n', last - first));
+        p = ( p != NULL ) ? p + 1 : last;
+        lines.push_back(tero::slice<const char>(first, p));
+        first = p;
+    }
+}
+
+
+size_t hashLine( const tero::slice<const char>& line ) {
+    /* FNV-1a */
+    size_t h = 2166136261u;
+    for( const char *p = line.begin(); p != line.end(); ++p ) {
+        h = (h ^ (unsigned char)*p) * 16777619u;
+    }
+    return h;
+}
+
+
+bool sameLine( const tero::slice<const char>& left,
+    const tero::slice<const char>& right ) {
+    return left.size() == right.size()
+        && memcmp(left.begin(), right.begin(), left.size()) == 0;
+}
+
+} // anonymous
+
+
+namespace tero {
+
+const size_t textDiff::npos = (size_t)-1;
+
+
+void textDiff::intern()
+{
+    /* open addressing hash table of line identifiers. */
+    size_t tableSize = 16;
+    while( tableSize < 2 * (leftLines.size() + rightLines.size()) ) {
+        tableSize <<= 1;
+    }
+    std::vector<size_t> table(tableSize, npos);
+    std::vector<size_t> hashes;
+    lineSet texts;
+
+    nbIds = 0;
+    lineSet *lines[] = { &leftLines, &rightLines };
+    std::vector<size_t> *ids[] = { &leftIds, &rightIds };
+    for( int side = 0; side < 2; ++side ) {
+        ids[side]->resize(lines[side]->size());
+        for( size_t i = 0; i < lines[side]->size(); ++i ) {
+            const slice<const char>& line = (*lines[side])[i];
+            size_t h = hashLine(line);
+            size_t slot = h & (tableSize - 1);
+            while( table[slot] != npos
+                && (hashes[table[slot]] != h
+                    || !sameLine(texts[table[slot]], line)) ) {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            if( table[slot] == npos ) {
+                table[slot] = nbIds++;
+                hashes.push_back(h);
+                texts.push_back(line);
+            }
+            (*ids[side])[i] = table[slot];
+        }
+    }
+}
+
+
+void textDiff::align( size_t leftFirst, size_t leftLast,
+    size_t rightFirst, size_t rightLast )
+{
+    while( leftFirst < leftLast && rightFirst < rightLast
+        && leftIds[leftFirst] == rightIds[rightFirst] ) {
+        match(leftFirst++, rightFirst++);
+    }
+    while( leftFirst < leftLast && rightFirst < rightLast
+        && leftIds[leftLast - 1] == rightIds[rightLast - 1] ) {
+        match(--leftLast, --rightLast);
+    }
+    if( leftFirst == leftLast || rightFirst == rightLast ) return;
+
+    /* Lines unique on both sides, in left order. */
+    for( size_t i = leftFirst; i < leftLast; ++i ) ++leftCount[leftIds[i]];
+    for( size_t j = rightFirst; j < rightLast; ++j ) {
+        ++rightCount[rightIds[j]];
+        rightPos[rightIds[j]] = j;
+    }
+    std::vector<std::pair<size_t,size_t> > uniques;
+    for( size_t i = leftFirst; i < leftLast; ++i ) {
+        size_t id = leftIds[i];
+        if( leftCount[id] == 1 && rightCount[id] == 1 ) {
+            uniques.push_back(std::make_pair(i, rightPos[id]));
+        }
+    }
+    for( size_t i = leftFirst; i < leftLast; ++i ) leftCount[leftIds[i]] = 0;
+    for( size_t j = rightFirst; j < rightLast; ++j ) {
+        rightCount[rightIds[j]] = 0;
+    }
+
+    /* Longest run of unique lines in the same order on both sides
+       (patience sorting). */
+    std::vector<size_t> tails;
+    std::vector<size_t> prevs(uniques.size(), npos);
+    for( size_t k = 0; k < uniques.size(); ++k ) {
+        size_t lo = 0, hi = tails.size();
+        while( lo < hi ) {
+            size_t mid = (lo + hi) / 2;
+            if( uniques[tails[mid]].second < uniques[k].second ) lo = mid + 1;
+            else hi = mid;
+        }
+        if( lo > 0 ) prevs[k] = tails[lo - 1];
+        if( lo == tails.size() ) tails.push_back(k);
+        else tails[lo] = k;
+    }
+    if( tails.empty() ) {
+        bisect(leftFirst, leftLast, rightFirst, rightLast);
+        return;
+    }
+    std::vector<size_t> anchors;
+    for( size_t k = tails.back(); k != npos; k = prevs[k] ) {
+        anchors.push_back(k);
+    }
+    for( std::vector<size_t>::const_reverse_iterator
+             k = anchors.rbegin(); k != anchors.rend(); ++k ) {
+        size_t i = uniques[*k].first;
+        size_t j = uniques[*k].second;
+        align(leftFirst, i, rightFirst, j);
+        match(i, j);
+        leftFirst = i + 1;
+        rightFirst = j + 1;
+    }
+    align(leftFirst, leftLast, rightFirst, rightLast);
+}
+
+
+void textDiff::bisect( size_t leftFirst, size_t leftLast,
+    size_t rightFirst, size_t rightLast )
+{
+    while( leftFirst < leftLast && rightFirst < rightLast
+        && leftIds[leftFirst] == rightIds[rightFirst] ) {
+        match(leftFirst++, rightFirst++);
+    }
+    while( leftFirst < leftLast && rightFirst < rightLast
+        && leftIds[leftLast - 1] == rightIds[rightLast - 1] ) {
+        match(--leftLast, --rightLast);
+    }
+    if( leftFirst == leftLast || rightFirst == rightLast ) return;
+
+    /* Finds the middle of a shortest edit path searching forward
+       from the start and backward from the end at the same time. */
+    const size_t *a = &leftIds[leftFirst];
+    const size_t *b = &rightIds[rightFirst];
+    int n = leftLast - leftFirst;
+    int m = rightLast - rightFirst;
+    int maxD = std::min((n + m + 1) / 2, maxEdits);
+    int offset = maxD + 1;
+    forward.assign(2 * offset + 1, -1);
+    backward.assign(2 * offset + 1, -1);
+    forward[offset + 1] = 0;
+    backward[offset + 1] = 0;
+    int delta = n - m;
+    bool odd = (delta % 2 != 0);
+    int kStart = 0, kEnd = 0, rStart = 0, rEnd = 0;
+    for( int d = 0; d < maxD; ++d ) {
+        for( int k = -d + kStart; k <= d - kEnd; k += 2 ) {
+            int x = ( k == -d || (k != d
+                    && forward[offset + k - 1] < forward[offset + k + 1]) ) ?
+                forward[offset + k + 1] : forward[offset + k - 1] + 1;
+            int y = x - k;
+            while( x < n && y < m && a[x] == b[y] ) { ++x; ++y; }
+            forward[offset + k] = x;
+            if( x > n ) {
+                kEnd += 2;
+            } else if( y > m ) {
+                kStart += 2;
+            } else if( odd ) {
+                int r = offset + delta - k;
+                if( r >= 0 && r < (int)backward.size()
+                    && backward[r] != -1 && x >= n - backward[r] ) {
+                    bisect(leftFirst, leftFirst + x, rightFirst, rightFirst + y);
+                    bisect(leftFirst + x, leftLast, rightFirst + y, rightLast);
+                    return;
+                }
+            }
+        }
+        for( int k = -d + rStart; k <= d - rEnd; k += 2 ) {
+            int x = ( k == -d || (k != d
+                    && backward[offset + k - 1] < backward[offset + k + 1]) ) ?
+                backward[offset + k + 1] : backward[offset + k - 1] + 1;
+            int y = x - k;
+            while( x < n && y < m && a[n - x - 1] == b[m - y - 1] ) {
+                ++x; ++y;
+            }
+            backward[offset + k] = x;
+            if( x > n ) {
+                rEnd += 2;
+            } else if( y > m ) {
+                rStart += 2;
+            } else if( !odd ) {
+                int f = offset + delta - k;
+                if( f >= 0 && f < (int)forward.size() && forward[f] != -1 ) {
+                    int fx = forward[f];
+                    int fy = fx - (f - offset);
+                    if( fx >= n - x ) {
+                        bisect(leftFirst, leftFirst + fx,
+                            rightFirst, rightFirst + fy);
+                        bisect(leftFirst + fx, leftLast,
+                            rightFirst + fy, rightLast);
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    /* Either the runs have nothing in common or aligning them 
+       would take too long. Both are reported as changed. */
+}
+
+
+void textDiff::report()
+{
+    size_t i = 0, j = 0;
+    while( i < leftLines.size() || j < rightLines.size() ) {
+        size_t leftStart = i, rightStart = j;
+        bool changed = !( i < leftLines.size() && leftMatch[i] == j );
+        if( changed ) {
+            while( i < leftLines.size() && leftMatch[i] == npos ) ++i;
+            while( j < rightLines.size() && rightMatch[j] == npos ) ++j;
+        } else {
+            while( i < leftLines.size() && leftMatch[i] == j ) { ++i; ++j; }
+        }
+        const char *leftPos = ( leftStart < leftLines.size() ) ?
+            leftLines[leftStart].begin()
+            : ( leftLines.empty() ? NULL : leftLines.back().end() );
+        const char *rightPos = ( rightStart < rightLines.size() ) ?
+            rightLines[rightStart].begin()
+            : ( rightLines.empty() ? NULL : rightLines.back().end() );
+        listener->hunk(
+            slice<const char>(leftPos,
+                i > leftStart ? leftLines[i - 1].end() : leftPos),
+            i - leftStart,
+            slice<const char>(rightPos,
+                j > rightStart ? rightLines[j - 1].end() : rightPos),
+            j - rightStart, changed);
+    }
+}
+
+
+void textDiff::diff( const slice<char>& left, const slice<char>& right )
+{
+    splitLines(leftLines, left.begin(), left.end());
+    splitLines(rightLines, right.begin(), right.end());
+    intern();
+    leftMatch.assign(leftLines.size(), npos);
+    rightMatch.assign(rightLines.size(), npos);
+    leftCount.assign(nbIds, 0);
+    rightCount.assign(nbIds, 0);
+    rightPos.resize(nbIds);
+    align(0, leftLines.size(), 0, rightLines.size());
+    if( listener != NULL ) report();
+}
+
+}
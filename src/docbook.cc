@@ -25,6 +25,7 @@
 
 #include "docbook.hh"
 #include "markup.hh"
+#include "feeds.hh"
 
 /** Display docbook as HTML.
 
@@ -885,4 +886,40 @@ void docbookFetch( session& s, const url& name )
     d.leftDec->detach();
 }
 
+
+void docbookPost( session& s, post& p, const url& name )
+{
+    using namespace RAPIDXML;
+
+    /* The session keeps the parsed document for docbookFetch. */
+    boost::filesystem::path pathname = s.abspath(name);
+    xml_document<> *doc = s.loadxml(pathname);
+
+    xml_node<> *title = NULL;
+    xml_node<> *root = doc ? doc->first_node() : NULL;
+    if( root != NULL ) {
+        xml_node<> *info = root->first_node("info");
+        if( info == NULL ) {
+            info = root->first_node("refmeta");
+        }
+        if( info != NULL ) {
+            title = info->first_node("title");
+        }
+    }
+    p.title = ( title != NULL && title->value_size() > 0 ) ?
+        std::string(title->value(),title->value_size()) : fileTitle(s,name);
+    p.author = fileAuthor(s,pathname);
+    p.time = fileTime(pathname);
+
+    std::string text;
+    if( doc != NULL ) {
+        captureOutput content(s);
+        docbookFetch(s,name);
+        text = content.str();
+    } else {
+        text = s.asUrl(pathname).string();
+    }
+    p.content.adopt(text);
+}
+
 }
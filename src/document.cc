@@ -23,7 +23,10 @@
    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <iomanip>
 #include <iostream>
+#include <unistd.h>
+#include <boost/filesystem/fstream.hpp>
 #include <boost/regex.hpp>
 #include <boost/program_options.hpp>
 #include <boost/system/error_code.hpp>
@@ -32,6 +35,7 @@
 #include <sys/stat.h>
 #include <pwd.h>
 #include "decorator.hh"
+#include "diff.hh"
 
 /** Base document functions
 
@@ -42,6 +46,23 @@ namespace tero {
 
 urlVariable nextpage("q","next page in a process pipeline");
 
+intVariable jobs("jobs","number of worker processes used to generate pages in parallel");
+
+intVariable checkThreads("checkThreads",
+    "number of threads used to check source files (defaults to the number of processors divided by jobs)");
+
+intVariable fragmentCacheSize("fragmentCacheSize",
+    "maximum size in kilobytes of rendered fragments kept in memory (0 disables the fragment cache)");
+
+intVariable highlightHighWater("highlightHighWater",
+    "size in kilobytes of text a syntax highlighter buffers before decorating it (0 buffers until the text is flushed)");
+
+pathVariable highlightCacheDir("highlightCacheDir",
+    "directory where syntax-highlighted source files are cached (empty disables the cache)");
+
+intVariable highlightCacheSize("highlightCacheSize",
+    "maximum size in kilobytes of the syntax-highlighted files cached on disk (defaults to 64 megabytes, 0 does not bound the cache)");
+
 
 void
 docAddSessionVars( boost::program_options::options_description& opts,
@@ -51,17 +72,78 @@ docAddSessionVars( boost::program_options::options_description& opts,
 
     options_description localOptions("document");
     localOptions.add(nextpage.option());
+    localOptions.add(checkThreads.option());
+    localOptions.add(fragmentCacheSize.option());
+    localOptions.add(highlightCacheDir.option());
+    localOptions.add(highlightCacheSize.option());
+    localOptions.add(highlightHighWater.option());
     opts.add(localOptions);
 }
 
 
+void fragmentCache::erase( fragmentMap::iterator f )
+{
+    totalSize -= f->second.text.size();
+    lru.erase(f->second.used);
+    fragments.erase(f);
+}
+
+
+const std::string* fragmentCache::find( session& s, const std::string& key )
+{
+    fragmentMap::iterator found = fragments.find(key);
+    if( found == fragments.end() ) {
+        ++misses;
+        return NULL;
+    }
+    for( stampMap::const_iterator dep = found->second.deps.begin();
+         dep != found->second.deps.end(); ++dep ) {
+        if( revisionsys::stamp(dep->first) != dep->second ) {
+            erase(found);
+            ++misses;
+            return NULL;
+        }
+    }
+    for( stampMap::const_iterator dep = found->second.deps.begin();
+         dep != found->second.deps.end(); ++dep ) {
+        s.depends(dep->first);
+    }
+    lru.splice(lru.begin(), lru, found->second.used);
+    ++hits;
+    return &found->second.text;
+}
+
+
+void fragmentCache::insert( const std::string& key, const std::string& text,
+    const session::dependencySet& deps )
+{
+    fragmentMap::iterator found = fragments.find(key);
+    if( found != fragments.end() ) erase(found);
+    if( text.size() > maxSize ) return;
+    while( totalSize + text.size() > maxSize && !lru.empty() ) {
+        erase(fragments.find(lru.back()));
+    }
+
+    fragment& f = fragments[key];
+    f.text = text;
+    for( session::dependencySet::const_iterator dep = deps.begin();
+         dep != deps.end(); ++dep ) {
+        f.deps[*dep] = revisionsys::stamp(*dep);
+    }
+    lru.push_front(key);
+    f.used = lru.begin();
+    totalSize += text.size();
+}
+
+
 dispatchDoc *dispatchDoc::singleton = NULL;
 
 
 dispatchDoc::dispatchDoc( fetchEntry* e, size_t n )
-    : entries(e), nbEntries(n) {
+    : entries(e), nbEntries(n), matchers(n,(regexSet*)NULL) {
     singleton = this;
     fetchEntry* prev = NULL;
+    regexSet *matcher = NULL;
     for( fetchEntry* first = entries; first != &entries[nbEntries]; ++first ) {
         if( prev ) {
             if( strcmp(prev->name,first->name) > 0  ) {
@@ -69,11 +151,27 @@ dispatchDoc::dispatchDoc( fetchEntry* e, size_t n )
                           << " and " << first->name << ")" << std::endl;
             }
         }
+        if( !prev || strcmp(prev->name,first->name) != 0 ) {
+            matcher = new regexSet();
+            matchers[first - entries] = matcher;
+        }
+        /* When a pattern cannot be compiled, select() falls back
+           to try each regular expression in turn. */
+        matcher->add(first->pat);
         prev = first;
     }
 }
 
 
+dispatchDoc::~dispatchDoc() {
+    for( std::vector<regexSet*>::iterator m = matchers.begin();
+         m != matchers.end(); ++m ) {
+        delete *m;
+    }
+    if( singleton == this ) singleton = NULL;
+}
+
+
 bool dispatchDoc::fetch( session& s,
     const std::string& name,
     const url& value ) {
@@ -113,9 +211,69 @@ void dispatchDoc::fetch( session& s,
         }
     }
 
+    /* Callbacks that populate feeds instead of writing output
+       cannot be replayed. */
+    if( (doc->behavior & whenCache) && s.feeds == NULL ) {
+        session::variables::const_iterator size
+            = s.find(fragmentCacheSize.name);
+        fragments.maxSize = s.found(size) ?
+            fragmentCacheSize.value(s) * 1024 : 4 * 1024 * 1024;
+        if( fragments.maxSize > 0 ) {
+            /* The output depends on the entry, the document and
+               the variables specific to the request. */
+            std::stringstream key;
+            key << doc->name << '\n' << (doc - entries) << '\n'
+                << value.string() << '\n';
+            session::variables vars;
+            s.filters(vars, session::sessionfile);
+            s.filters(vars, session::queryenv);
+            for( session::variables::const_iterator v = vars.begin();
+                 v != vars.end(); ++v ) {
+                key << v->first << '=' << v->second.value << '\n';
+            }
+            const std::string *cached = fragments.find(s, key.str());
+            if( cached ) {
+                s.out() << *cached;
+                return;
+            }
+
+            std::stringstream capture;
+            std::ostream& prevOut = s.out(capture);
+            session::dependencySet deps;
+            session::dependencySet *prevDeps = s.dependencies(&deps);
+            unsigned int nErrs = s.nErrs;
+            try {
+                invoke(s, doc, value);
+            } catch( ... ) {
+                s.out(prevOut);
+                s.dependencies(prevDeps);
+                if( prevDeps ) prevDeps->insert(deps.begin(), deps.end());
+                prevOut << capture.str();
+                throw;
+            }
+            s.out(prevOut);
+            s.dependencies(prevDeps);
+            if( prevDeps ) prevDeps->insert(deps.begin(), deps.end());
+            std::string text = capture.str();
+            prevOut << text;
+            if( s.nErrs == nErrs ) {
+                fragments.insert(key.str(), text, deps);
+            }
+            return;
+        }
+    }
+    invoke(s, doc, value);
+}
+
+
+void dispatchDoc::invoke( session& s,
+    const fetchEntry *doc,
+    const url& value ) {
+    using namespace boost::filesystem;
+
     /* fetch the document using the appropriate method. */
     if( doc->textFetch ) {
-        slice<char> text;
+        sharedSlice<char> text;
         boost::filesystem::path p = s.abspath(value);
         path prevcwd = current_path();
         path dir = s.prefixdir(p);
@@ -162,6 +320,10 @@ dispatchDoc::select( const std::string& name, const std::string& value ) const {
     fetchEntry *lastEntry = &entries[nbEntries];
     fetchEntry *first = std::lower_bound(entries,lastEntry,cmp);
     fetchEntry *last = std::upper_bound(entries,lastEntry,cmp);
+    if( first != last && matchers[first - entries]->compiled() ) {
+        int found = matchers[first - entries]->match(value);
+        return found >= 0 ? first + found : NULL;
+    }
     if( first != lastEntry ) {
         for( fetchEntry *start = first; start != last; ++start ) {
             boost::smatch m;
@@ -232,6 +394,7 @@ void dirwalker::recurse( session& s, revisionsys *rev,
             }
         }
     } else {
+        s.depends(nodedir);
         for( directory_iterator entry = directory_iterator(nodedir);
              entry != directory_iterator(); ++entry ) {
             if( is_directory(*entry) ) {
@@ -264,207 +427,75 @@ void dirwalker::fetch( session& s, const boost::filesystem::path& pathname )
 }
 
 
-void
-text::showSideBySide( session& s,
-    std::istream& input,
-    std::istream& diff,
-    bool inputIsLeftSide ) const {
-    using namespace std;
-
-    std::stringstream left, right;
-    size_t leftLine = 1;
-    bool areDiffBlocks = false;
-    int nbLeftLinesAhead = 0, nbRightLinesAhead = 0;
-    char leftMarker = inputIsLeftSide ? '-' : '+';
-    char rightMarker = inputIsLeftSide ? '+' : '-';
-
-    leftDec->attach(left);
-    rightDec->attach(right);
-    while( !diff.eof() ) {
-        std::string line;
-        getline(diff,line);
-        if( line.compare(0,3,"+++") == 0
-            || line.compare(0,3,"---") == 0 ) {
-
-        } else if( line.compare(0,2,"@@") == 0 ) {
-            if( areDiffBlocks ) {
-                s.out() << "<tr class=\"diffConflict\">" << endl;
-                s.out() << html::td();
-                if( leftDec->formated() ) s.out() << code();
-                s.out() << left.str();
-                if( nbLeftLinesAhead < nbRightLinesAhead ) {
-                    for( int i = 0; i < (nbRightLinesAhead - nbLeftLinesAhead); ++i ) { 
-                        s.out() << std::endl;
-                    }
-                }
-                if( leftDec->formated() ) s.out() << html::pre::end;
-                s.out() << html::td::end;
-                s.out() << html::td();
-                if( rightDec->formated() ) s.out() << code();
-                s.out() << right.str();
-                if(  nbLeftLinesAhead > nbRightLinesAhead ) {
-                    for( int i = 0; i < (nbLeftLinesAhead - nbRightLinesAhead); ++i ) {
-                        s.out() << endl;
-                    }
-                }
-                if( rightDec->formated() ) s.out() << html::pre::end;
-                s.out() << html::td::end;
-                s.out() << html::tr::end;
-                left.str("");
-                right.str("");
-            }
+namespace {
 
-            const char *p = strchr(line.c_str(),leftMarker);
-            size_t start = atoi(&p[1]);
-            /* read left file until we hit the start line */
-            while( leftLine < start ) {
-                std::string l;
-                getline(input,l);
-                left << l << endl;
-                right << l << endl;
-                ++leftLine;
-            }
-            nbLeftLinesAhead = nbRightLinesAhead = 0;
-            areDiffBlocks = false;
-
-        } else if( line[0] == rightMarker ) {
-            if( !areDiffBlocks & !left.str().empty() ) {
-                s.out() << html::tr();
-                s.out() << html::td();
-                if( leftDec->formated() ) s.out() << code();
-                s.out() << left.str();
-                if( leftDec->formated() ) s.out() << html::pre::end;
-                s.out() << html::td::end;
-                s.out() << html::td();
-                if( rightDec->formated() ) s.out() << code();
-                s.out() << right.str();
-                if( rightDec->formated() ) s.out() << html::pre::end;
-                s.out() << html::td::end;
-                s.out() << html::tr::end;
-                left.str("");
-                right.str("");
-            }
-            ++nbRightLinesAhead;
-            areDiffBlocks = true;
-            right << line.substr(1) << endl;
-
-        } else if( line[0] == leftMarker ) {
-            if( !areDiffBlocks & !left.str().empty() ) {
-                s.out() << html::tr();
-                s.out() << html::td();
-                if( leftDec->formated() ) s.out() << code();
-                s.out() << left.str();
-                if( leftDec->formated() ) s.out() << html::pre::end;
-                s.out() << html::td::end;
-                s.out() << html::td();
-                if( rightDec->formated() ) s.out() << code();
-                s.out() << right.str();
-                if( rightDec->formated() ) s.out() << html::pre::end;
-                s.out() << html::td::end;
-                s.out() << html::tr::end;
-                left.str("");
-                right.str("");
-            }
-            std::string l;
-            getline(input,l);
-            ++nbLeftLinesAhead;
-            areDiffBlocks = true;
-            left << l << endl;
-            ++leftLine;
-
-        } else if( line[0] == ' ' ) {
-            if( areDiffBlocks ) {
-                s.out() << "<tr class=\"diff"
-                        << ((!left.str().empty() & !right.str().empty()) ? "" : "No") 
-                        << "Conflict\">" << endl;
-                s.out() << html::td();
-                if( leftDec->formated() ) s.out() << code();
-                s.out() << left.str();
-                if( nbLeftLinesAhead < nbRightLinesAhead ) {
-                    for( int i = 0; i < (nbRightLinesAhead - nbLeftLinesAhead); ++i ) { 
-                        s.out() << std::endl;
-                    }
-                }
-                if( leftDec->formated() ) s.out() << html::pre::end;
-                s.out() << html::td::end;
-                s.out() << html::td();
-                if( rightDec->formated() ) s.out() << code();
-                s.out() << right.str();
-                if(  nbLeftLinesAhead > nbRightLinesAhead ) {
-                    for( int i = 0; i < (nbLeftLinesAhead - nbRightLinesAhead); ++i ) { 
-                        s.out() << endl;
-                    }
-                }
-                if( rightDec->formated() ) s.out() << html::pre::end;
-                s.out() << html::td::end;
-                s.out() << html::tr::end;
-                left.str("");
-                right.str("");
-                areDiffBlocks = false;
-                nbLeftLinesAhead = nbRightLinesAhead = 0;
-            }
-            std::string l;
-            getline(input,l);
-            left << l << endl;
-            ++leftLine;
-            right << line.substr(1) << endl;
-        }
+/** Writes the hunks of a diff as the rows of a two columns table,
+    each column decorated through its own decorator. */
+class sideBySide : public diffListener {
+protected:
+    session& s;
+    decorator *leftDec;
+    decorator *rightDec;
+
+    void cell( decorator *dec, const slice<const char>& text,
+        size_t nbLines, size_t nbPadLines );
+
+public:
+    sideBySide( session& ps, decorator *l, decorator *r )
+        : s(ps), leftDec(l), rightDec(r) {}
+
+    void hunk( const slice<const char>& left, size_t leftLines,
+        const slice<const char>& right, size_t rightLines, bool changed );
+};
+
+
+void sideBySide::cell( decorator *dec, const slice<const char>& text,
+    size_t nbLines, size_t nbPadLines )
+{
+    s.out() << html::td();
+    if( dec->formated() ) s.out() << code();
+    /* The decorator keeps its state from one cell to the next
+       such that the column is decorated as a single text. */
+    dec->attach(s.out());
+    s.out() << text;
+    if( text.size() > 0 && text.end()[-1] != '\n' ) {
+        s.out() << '\n';
     }
-    if( !left.str().empty() | !right.str().empty() ) {
-        if( areDiffBlocks ) {
-            s.out() << "<tr class=\"diff"
-                    << ((!left.str().empty() & !right.str().empty()) ? "" : "No") 
-                    << "Conflict\">" << endl;
-        } else {
-            s.out() << html::tr();
-        }
-        s.out() << html::td();
-        if( leftDec->formated() ) s.out() << code();
-        s.out() << left.str();
-        if( nbLeftLinesAhead < nbRightLinesAhead ) {
-            for( int i = 0; i < (nbRightLinesAhead - nbLeftLinesAhead); ++i ) {
-                s.out() << std::endl;
-            }
-        }
-        if( leftDec->formated() ) s.out() << html::pre::end;
-        s.out() << html::td::end;
-        s.out() << html::td();
-        if( rightDec->formated() ) s.out() << code();
-        s.out() << right.str();
-        if(  nbLeftLinesAhead > nbRightLinesAhead ) {
-            for( int i = 0; i < (nbLeftLinesAhead - nbRightLinesAhead); ++i ) {
-                s.out() << endl;
-            }
-        }
-        if( rightDec->formated() ) s.out() << html::pre::end;
-        s.out() << html::td::end;
-        s.out() << html::tr::end;
-        left.str("");
-        right.str("");
-    }
-    if( !input.eof() ) {
-        while( !input.eof() ) {
-            std::string line;
-            getline(input,line);
-            left << line << endl;
-            right << line << endl;
-        }
+    dec->detach();
+    for( size_t i = nbLines; i < nbPadLines; ++i ) {
+        s.out() << std::endl;
+    }
+    if( dec->formated() ) s.out() << html::pre::end;
+    s.out() << html::td::end;
+}
+
+
+void sideBySide::hunk( const slice<const char>& left, size_t leftLines,
+    const slice<const char>& right, size_t rightLines, bool changed )
+{
+    if( changed ) {
+        s.out() << "<tr class=\"diff"
+                << ((leftLines > 0 && rightLines > 0) ? "" : "No")
+                << "Conflict\">" << std::endl;
+    } else {
         s.out() << html::tr();
-        s.out() << html::td();
-        if( leftDec->formated() ) s.out() << code();
-        s.out() << left.str();
-        if( leftDec->formated() ) s.out() << html::pre::end;
-        s.out() << html::td::end;
-        s.out() << html::td();
-        if( rightDec->formated() ) s.out() << code();
-        s.out() << right.str();
-        if( rightDec->formated() ) s.out() << html::pre::end;
-        s.out() << html::td::end;
-        s.out() << html::tr::end;
     }
+    cell(leftDec, left, leftLines, rightLines);
+    cell(rightDec, right, rightLines, leftLines);
+    s.out() << html::tr::end;
+}
+
+} // anonymous
+
 
-    leftDec->detach();
-    rightDec->detach();
+void
+text::showSideBySide( session& s,
+    const slice<char>& left,
+    const slice<char>& right ) const
+{
+    sideBySide renderer(s, leftDec, rightDec);
+    textDiff differences(renderer);
+    differences.diff(left, right);
 }
 
 
@@ -485,14 +516,183 @@ void skipOverTags( session& s, std::istream& istr )
 }
 
 
-void text::fetch( session& s, std::istream& in )
+highlightCache::highlightCache( session& s )
+    : maxSize(64 * 1024 * 1024)
+{
+    session::variables::const_iterator found
+        = s.find(highlightCacheDir.name);
+    if( s.found(found) && !found->second.value.empty() ) {
+        dir = highlightCacheDir.value(s);
+    }
+    session::variables::const_iterator size
+        = s.find(highlightCacheSize.name);
+    if( s.found(size) ) {
+        maxSize = (boost::uintmax_t)highlightCacheSize.value(s) * 1024;
+    }
+}
+
+
+boost::filesystem::path
+highlightCache::entryPath( const std::string& key ) const
+{
+    /* FNV-1a. The full key is stored in the entry to detect collisions. */
+    unsigned long long hash = 14695981039346656037ULL;
+    for( std::string::const_iterator c = key.begin(); c != key.end(); ++c ) {
+        hash ^= (unsigned char)*c;
+        hash *= 1099511628211ULL;
+    }
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash << ".html";
+    return dir / name.str();
+}
+
+
+std::string highlightCache::key( session& s,
+    const boost::filesystem::path& pathname, const char *chainId ) const
+{
+    std::string id = revisionsys::findRevContentId(s, pathname);
+    if( id.empty() ) return id;
+    /* Relative links are resolved against the location of the source
+       file and decorated links depend on the site. */
+    std::stringstream key;
+    key << chainId << '\t' << id << '\t' << pathname.string()
+        << '\t' << s.valueOf(siteTop.name)
+        << '\t' << s.valueOf(domainName.name);
+    return key.str();
+}
+
+
+bool highlightCache::replay( session& s, const std::string& key ) const
+{
+    boost::filesystem::path pathname = entryPath(key);
+    boost::filesystem::ifstream entry(pathname);
+    std::string line;
+    if( !std::getline(entry,line) || line != "semilla-highlight 1"
+        || !std::getline(entry,line) || line != key ) {
+        return false;
+    }
+    while( std::getline(entry,line) && !line.empty() ) {
+        if( line.compare(0,5,"link ") == 0 ) {
+            linkLight::record(url(line.substr(5)));
+        }
+    }
+    if( entry.peek() != EOF ) {
+        s.out() << entry.rdbuf();
+    }
+    /* The modification time orders entries for prune. */
+    if( maxSize > 0 ) {
+        boost::system::error_code ec;
+        last_write_time(pathname,std::time(NULL),ec);
+    }
+    return true;
+}
+
+
+namespace {
+
+/* Bytes stored in each cache directory as last known by this process.
+   Stores add to the estimate such that the directory is only scanned
+   again once it may have grown past the bound. */
+typedef std::map<boost::filesystem::path,boost::uintmax_t> cacheSizeMap;
+cacheSizeMap cacheSizes;
+
+} // anonymous
+
+
+void highlightCache::prune() const
+{
+    using namespace boost::filesystem;
+
+    typedef std::multimap<std::time_t,
+        std::pair<path,boost::uintmax_t> > entrySet;
+    entrySet entries;
+    boost::uintmax_t totalSize = 0;
+    boost::system::error_code ec;
+    for( directory_iterator e = directory_iterator(dir,ec);
+         e != directory_iterator(); e.increment(ec) ) {
+        if( ec ) return;
+        path pathname(*e);
+        /* Temporary files (*entry*.html.*pid*) are still being written
+           by a concurrent store and are not entries yet. */
+        if( pathname.extension() != ".html" ) continue;
+        if( !is_regular_file(pathname,ec) ) continue;
+        boost::uintmax_t size = file_size(pathname,ec);
+        if( ec ) continue;
+        std::time_t mtime = last_write_time(pathname,ec);
+        if( ec ) continue;
+        entries.insert(std::make_pair(mtime,std::make_pair(pathname,size)));
+        totalSize += size;
+    }
+    if( totalSize > maxSize ) {
+        /* Remove the least recently used entries down to three quarters
+           of the bound such that the next stores do not prune again. */
+        boost::uintmax_t lowWater = maxSize - maxSize / 4;
+        for( entrySet::const_iterator e = entries.begin();
+             e != entries.end() && totalSize > lowWater; ++e ) {
+            if( remove(e->second.first,ec) ) {
+                totalSize -= e->second.second;
+            }
+        }
+    }
+    cacheSizes[dir] = totalSize;
+}
+
+
+void highlightCache::store( const std::string& key, const std::string& text,
+    const linkSet& links ) const
 {
-    using namespace boost;
-    using namespace boost::system;
     using namespace boost::filesystem;
 
+    path pathname = entryPath(key);
+    std::stringstream tmpname;
+    tmpname << pathname.string() << '.' << getpid();
+    path tmp(tmpname.str());
+    {
+        ofstream entry(tmp);
+        entry << "semilla-highlight 1\n" << key << '\n';
+        for( linkSet::const_iterator l = links.begin();
+             l != links.end(); ++l ) {
+            entry << "link " << l->string() << '\n';
+        }
+        entry << '\n' << text;
+        if( !entry.good() ) {
+            entry.close();
+            boost::system::error_code ec;
+            remove(tmp,ec);
+            return;
+        }
+    }
+    /* rename is atomic such that concurrent requests either see
+       the previous entry or the complete new one. */
+    boost::system::error_code ec;
+    rename(tmp,pathname,ec);
+    if( ec ) {
+        remove(tmp,ec);
+        return;
+    }
+    if( maxSize > 0 ) {
+        /* Replacing an entry over-counts its previous size, which only
+           brings the next scan earlier. */
+        cacheSizeMap::iterator known = cacheSizes.find(dir);
+        if( known == cacheSizes.end() ) {
+            prune();
+        } else {
+            boost::uintmax_t size = file_size(pathname,ec);
+            known->second += ec ? text.size() : size;
+            if( known->second > maxSize ) prune();
+        }
+    }
+}
+
+
+void text::decorate( session& s, std::istream& in )
+{
     if( leftDec ) {
-        if( leftDec->formated() ) s.out() << code();
+        session::variables::const_iterator highWater
+            = s.find(highlightHighWater.name);
+        leftDec->highWater(s.found(highWater) ?
+            highlightHighWater.value(s) * 1024
+            : (size_t)decorator::defaultHighWaterMark);
         leftDec->attach(s.out());
     }
 
@@ -506,11 +706,57 @@ void text::fetch( session& s, std::istream& in )
 
     if( leftDec ) {
         leftDec->detach();
-        if( leftDec->formated() ) s.out() << html::pre::end;
     }
 }
 
 
+void text::fetch( session& s, std::istream& in )
+{
+    if( leftDec && leftDec->formated() ) s.out() << code();
+    decorate(s,in);
+    if( leftDec && leftDec->formated() ) s.out() << html::pre::end;
+}
+
+
+void text::fetch( session& s, std::istream& in, const url& name )
+{
+    highlightCache cache(s);
+    std::string key;
+    if( chainId != NULL && cache.enabled() ) {
+        key = cache.key(s, s.abspath(name), chainId);
+    }
+    if( key.empty() ) {
+        fetch(s,in);
+        return;
+    }
+
+    if( leftDec && leftDec->formated() ) s.out() << code();
+    if( !cache.replay(s,key) ) {
+        std::stringstream capture;
+        std::ostream& prevOut = s.out(capture);
+        highlightCache::linkSet links;
+        linkLight::linkSet *prevLinks = linkLight::pageLinks;
+        linkLight::pageLinks = &links;
+        try {
+            decorate(s,in);
+        } catch( ... ) {
+            s.out(prevOut);
+            linkLight::pageLinks = prevLinks;
+            if( prevLinks ) prevLinks->insert(links.begin(), links.end());
+            prevOut << capture.str();
+            throw;
+        }
+        s.out(prevOut);
+        linkLight::pageLinks = prevLinks;
+        if( prevLinks ) prevLinks->insert(links.begin(), links.end());
+        std::string text = capture.str();
+        cache.store(key, text, links);
+        prevOut << text;
+    }
+    if( leftDec && leftDec->formated() ) s.out() << html::pre::end;
+}
+
+
 void textFetch( session& s, std::istream& in, const url& name )
 {
     htmlEscaper leftLinkText;
@@ -545,6 +791,11 @@ void metaValue( session& s, const url& name )
 
 
 void metaFileOwner( session& s, const boost::filesystem::path& pathname ) {
+    s.out() << fileOwner(s,pathname);
+}
+
+
+std::string fileOwner( session& s, const boost::filesystem::path& pathname ) {
     using namespace boost::filesystem;
 
     std::string author("anonymous");
@@ -560,7 +811,7 @@ void metaFileOwner( session& s, const boost::filesystem::path& pathname ) {
     authorEmail += std::string("@") + domainName.value(s).string();
     s.insert("author",author);
     s.insert("authorEmail",authorEmail);
-    s.out() << author;
+    return author;
 }
 
 }
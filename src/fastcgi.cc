@@ -0,0 +1,403 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <boost/system/system_error.hpp>
+#include <boost/throw_exception.hpp>
+#include "fastcgi.hh"
+
+/** Minimal FastCGI responder
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace {
+
+enum fcgiRecordType {
+    fcgiBeginRequest = 1,
+    fcgiAbortRequest = 2,
+    fcgiEndRequest = 3,
+    fcgiParams = 4,
+    fcgiStdin = 5,
+    fcgiStdout = 6,
+    fcgiStderr = 7,
+    fcgiData = 8,
+    fcgiGetValues = 9,
+    fcgiGetValuesResult = 10,
+    fcgiUnknownType = 11
+};
+
+enum fcgiProtocolStatus {
+    fcgiRequestComplete = 0,
+    fcgiCantMpxConn = 1,
+    fcgiOverloaded = 2,
+    fcgiUnknownRole = 3
+};
+
+const unsigned char fcgiVersion = 1;
+const unsigned int fcgiResponder = 1;
+const unsigned char fcgiKeepConn = 1;
+const size_t fcgiMaxContent = 65535;
+
+
+/** Reads a name or value length as encoded in FastCGI name-value pairs.
+ */
+bool decodeLength( const std::string& content, size_t& pos, size_t& len )
+{
+    if( pos >= content.size() ) return false;
+    const unsigned char *p = (const unsigned char*)&content[pos];
+    if( (p[0] & 0x80) == 0 ) {
+        len = p[0];
+        pos += 1;
+        return true;
+    }
+    if( pos + 4 > content.size() ) return false;
+    len = ((p[0] & 0x7f) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    pos += 4;
+    return true;
+}
+
+
+void encodeLength( std::string& content, size_t len )
+{
+    if( len < 0x80 ) {
+        content += (char)len;
+    } else {
+        content += (char)(((len >> 24) & 0x7f) | 0x80);
+        content += (char)((len >> 16) & 0xff);
+        content += (char)((len >> 8) & 0xff);
+        content += (char)(len & 0xff);
+    }
+}
+
+
+/** Reads exactly *len* bytes from *fd*. Returns false on end of stream.
+ */
+bool readFully( int fd, char *buffer, size_t len )
+{
+    while( len > 0 ) {
+        ssize_t n = ::read(fd,buffer,len);
+        if( n < 0 && errno == EINTR ) continue;
+        if( n <= 0 ) return false;
+        buffer += n;
+        len -= n;
+    }
+    return true;
+}
+
+} // anonymous
+
+
+namespace tero {
+
+fastcgiStreambuf::fastcgiStreambuf( fastcgi& c )
+    : conn(&c)
+{
+    setp(buffer,buffer + bufferSize);
+}
+
+
+fastcgiStreambuf::int_type fastcgiStreambuf::overflow( int_type c )
+{
+    sync();
+    if( !traits_type::eq_int_type(c,traits_type::eof()) ) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+        return c;
+    }
+    return traits_type::not_eof(c);
+}
+
+
+int fastcgiStreambuf::sync()
+{
+    if( pptr() > pbase() ) {
+        conn->writeRecord(fcgiStdout,conn->requestId,pbase(),pptr() - pbase());
+        setp(buffer,buffer + bufferSize);
+    }
+    return 0;
+}
+
+
+fastcgi::fastcgi( int fd )
+    : listenfd(fd), connfd(-1), requestId(0), closeConn(true),
+      obuf(*this), ostr(&obuf)
+{
+}
+
+
+fastcgi::~fastcgi()
+{
+    if( connfd >= 0 ) {
+        ::close(connfd);
+    }
+}
+
+
+bool fastcgi::readRecord( unsigned char& type, unsigned int& reqId,
+    std::string& content )
+{
+    unsigned char header[8];
+    if( !readFully(connfd,(char*)header,sizeof(header)) ) return false;
+    type = header[1];
+    reqId = (header[2] << 8) | header[3];
+    size_t contentLength = (header[4] << 8) | header[5];
+    size_t paddingLength = header[6];
+    content.resize(contentLength + paddingLength);
+    if( contentLength + paddingLength > 0
+        && !readFully(connfd,&content[0],contentLength + paddingLength) ) {
+        return false;
+    }
+    content.resize(contentLength);
+    return true;
+}
+
+
+void fastcgi::writeRecord( unsigned char type, unsigned int reqId,
+    const char *content, size_t length )
+{
+    do {
+        /* We send at least one record, such that an empty *content*
+           marks the end of a stream. */
+        size_t len = std::min(length,fcgiMaxContent);
+        size_t padding = (8 - (len % 8)) % 8;
+        char header[8] = { (char)fcgiVersion, (char)type,
+                           (char)((reqId >> 8) & 0xff), (char)(reqId & 0xff),
+                           (char)((len >> 8) & 0xff), (char)(len & 0xff),
+                           (char)padding, 0 };
+        static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        struct segment {
+            const char *base;
+            size_t len;
+        } parts[3] = { { header, sizeof(header) },
+                       { content, len },
+                       { zeros, padding } };
+        for( int i = 0; i < 3 && connfd >= 0; ++i ) {
+            const char *p = parts[i].base;
+            size_t left = parts[i].len;
+            while( left > 0 ) {
+                /* MSG_NOSIGNAL such that a client that went away
+                   does not kill the process with a SIGPIPE. */
+                ssize_t n = ::send(connfd,p,left,MSG_NOSIGNAL);
+                if( n < 0 && errno == EINTR ) continue;
+                if( n <= 0 ) {
+                    ::close(connfd);
+                    connfd = -1;
+                    break;
+                }
+                p += n;
+                left -= n;
+            }
+        }
+        content += len;
+        length -= len;
+    } while( length > 0 );
+}
+
+
+void fastcgi::params( const std::string& content )
+{
+    size_t pos = 0;
+    size_t nameLen, valueLen;
+    while( decodeLength(content,pos,nameLen)
+        && decodeLength(content,pos,valueLen)
+        && pos + nameLen + valueLen <= content.size() ) {
+        std::string name(content,pos,nameLen);
+        pos += nameLen;
+        std::string value(content,pos,valueLen);
+        pos += valueLen;
+        setenv(name.c_str(),value.c_str(),1);
+        envnames.push_back(name);
+    }
+}
+
+
+void fastcgi::values( const std::string& content )
+{
+    std::string result;
+    size_t pos = 0;
+    size_t nameLen, valueLen;
+    while( decodeLength(content,pos,nameLen)
+        && decodeLength(content,pos,valueLen)
+        && pos + nameLen + valueLen <= content.size() ) {
+        std::string name(content,pos,nameLen);
+        pos += nameLen + valueLen;
+        const char *value = NULL;
+        if( name == "FCGI_MAX_CONNS" || name == "FCGI_MAX_REQS" ) {
+            value = "1";
+        } else if( name == "FCGI_MPXS_CONNS" ) {
+            value = "0";
+        }
+        if( value ) {
+            encodeLength(result,name.size());
+            encodeLength(result,strlen(value));
+            result += name;
+            result += value;
+        }
+    }
+    writeRecord(fcgiGetValuesResult,0,result.data(),result.size());
+}
+
+
+bool fastcgi::accept()
+{
+    using namespace boost::system;
+
+    /* Clean-up the environment from the previous request. */
+    for( std::vector<std::string>::const_iterator name = envnames.begin();
+         name != envnames.end(); ++name ) {
+        unsetenv(name->c_str());
+    }
+    envnames.clear();
+    body.str("");
+    body.clear();
+    requestId = 0;
+
+    std::string params;
+    std::string content;
+    while( true ) {
+        if( connfd < 0 ) {
+            connfd = ::accept(listenfd,NULL,NULL);
+            if( connfd < 0 ) {
+                if( errno == EINTR ) continue;
+                if( errno == ENOTSOCK ) {
+                    boost::throw_exception(system_error(errno,
+                            system_category(),
+                            "fastcgi mode expects a listening socket"
+                            " as standard input"));
+                }
+                return false;
+            }
+            requestId = 0;
+        }
+
+        unsigned char type;
+        unsigned int reqId;
+        if( !readRecord(type,reqId,content) ) {
+            /* The web server closed the connection, possibly
+               in the middle of a request. */
+            ::close(connfd);
+            connfd = -1;
+            requestId = 0;
+            continue;
+        }
+
+        if( reqId == 0 ) {
+            /* management records */
+            if( type == fcgiGetValues ) {
+                values(content);
+            } else {
+                char unknown[8] = { (char)type, 0, 0, 0, 0, 0, 0, 0 };
+                writeRecord(fcgiUnknownType,0,unknown,sizeof(unknown));
+            }
+            continue;
+        }
+
+        switch( type ) {
+        case fcgiBeginRequest: {
+            unsigned int role = content.size() >= 3 ?
+                (((unsigned char)content[0] << 8)
+                    | (unsigned char)content[1]) : 0;
+            if( requestId != 0 || role != fcgiResponder ) {
+                char end[8] = { 0, 0, 0, 0,
+                                (char)(requestId != 0 ?
+                                    fcgiCantMpxConn : fcgiUnknownRole),
+                                0, 0, 0 };
+                writeRecord(fcgiEndRequest,reqId,end,sizeof(end));
+                break;
+            }
+            requestId = reqId;
+            closeConn = ((unsigned char)content[2] & fcgiKeepConn) == 0;
+            params.clear();
+        } break;
+        case fcgiAbortRequest:
+            if( reqId == requestId ) {
+                char end[8] = { 0, 0, 0, 0, fcgiRequestComplete, 0, 0, 0 };
+                writeRecord(fcgiEndRequest,reqId,end,sizeof(end));
+                for( std::vector<std::string>::const_iterator
+                         name = envnames.begin();
+                     name != envnames.end(); ++name ) {
+                    unsetenv(name->c_str());
+                }
+                envnames.clear();
+                body.str("");
+                body.clear();
+                requestId = 0;
+                if( closeConn ) {
+                    ::close(connfd);
+                    connfd = -1;
+                }
+            }
+            break;
+        case fcgiParams:
+            if( reqId != requestId ) break;
+            if( content.empty() ) {
+                this->params(params);
+            } else {
+                params += content;
+            }
+            break;
+        case fcgiStdin:
+            if( reqId != requestId ) break;
+            if( content.empty() ) {
+                /* end of the request content, the request
+                   can be processed. */
+                return true;
+            }
+            body.write(content.data(),content.size());
+            break;
+        default:
+            /* fcgiData is only used by the filter role. */
+            break;
+        }
+    }
+    return false;
+}
+
+
+void fastcgi::finish( int appStatus )
+{
+    ostr.flush();
+    writeRecord(fcgiStdout,requestId,NULL,0);
+    char end[8] = { (char)((appStatus >> 24) & 0xff),
+                    (char)((appStatus >> 16) & 0xff),
+                    (char)((appStatus >> 8) & 0xff),
+                    (char)(appStatus & 0xff),
+                    fcgiRequestComplete, 0, 0, 0 };
+    writeRecord(fcgiEndRequest,requestId,end,sizeof(end));
+    requestId = 0;
+    if( closeConn && connfd >= 0 ) {
+        ::close(connfd);
+        connfd = -1;
+    }
+}
+
+}
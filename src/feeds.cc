@@ -65,7 +65,9 @@ void summarize::filters( const post& v )
 {
     if( next ) {
         post p = v;
-        p.content = p.content.substr(0,std::min(length,p.content.size()));
+        if( p.content.size() > length ) {
+            p.content = p.content.str().substr(0,length);
+        }
         next->filters(p);
     }
 }
@@ -116,5 +118,65 @@ void byTimeHtml::filters( const post& p ) {
     prev_header = p.time;
 }
 
+
+bool fetchText( session& s, std::string& text,
+    const std::string& varname, const url& name )
+{
+    captureOutput capture(s);
+    bool found = dispatchDoc::instance()->fetch(s,varname,name);
+    text = capture.str();
+    return found;
+}
+
+
+std::string fileTitle( session& s, const url& name )
+{
+    session::variables::const_iterator look = s.find(titleVar.name);
+    if( s.found(look) ) {
+        return look->second.value;
+    }
+    std::stringstream title;
+    title << s.subdirpart(siteTop.value(s),s.abspath(name));
+    return title.str();
+}
+
+
+contrib::pointer_type fileAuthor( session& s,
+    const boost::filesystem::path& pathname )
+{
+    std::string owner = fileOwner(s,pathname);
+    return contrib::find(authorEmail.value(s),owner);
+}
+
+
+boost::posix_time::ptime fileTime( const boost::filesystem::path& pathname )
+{
+    return boost::posix_time::from_time_t(last_write_time(pathname));
 }
 
+
+void postContent( session& s, post& p, const url& name )
+{
+    /* \todo Be careful here, if there are no *.blog pattern
+       but there is a /blog/.* pattern in the dispatch table,
+       this will create an infinite loop that only stops when
+       the system runs out of file descriptor. I am not sure
+       how to avoid or pop an error for this case yet. */
+    std::string text;
+    if( !fetchText(s,text,"content",name) ) {
+        text = s.asUrl(s.abspath(name)).string();
+    }
+    p.content.adopt(text);
+}
+
+
+void filePost( session& s, post& p, const url& name )
+{
+    boost::filesystem::path pathname = s.abspath(name);
+    p.title = fileTitle(s,name);
+    p.author = fileAuthor(s,pathname);
+    p.time = fileTime(pathname);
+    postContent(s,p,name);
+}
+
+}
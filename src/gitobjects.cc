@@ -0,0 +1,589 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include "gitobjects.hh"
+
+/** Read objects out of a git repository without spawning git.
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace {
+
+const char *typeNames[] = { "", "commit", "tree", "blob", "tag" };
+
+unsigned int getBigEndian32( const char *p ) {
+    const unsigned char *b = (const unsigned char*)p;
+    return ((unsigned int)b[0] << 24) | ((unsigned int)b[1] << 16)
+        | ((unsigned int)b[2] << 8) | (unsigned int)b[3];
+}
+
+
+/** Reads *size* bytes at *offset* in *fd*, returns the number of bytes
+    actually read. */
+size_t readAt( int fd, char *buf, size_t size, unsigned long long offset )
+{
+    size_t total = 0;
+    while( total < size ) {
+        ssize_t n = pread(fd, buf + total, size - total, offset + total);
+        if( n < 0 && errno == EINTR ) continue;
+        if( n <= 0 ) break;
+        total += n;
+    }
+    return total;
+}
+
+
+/** Inflates the zlib stream starting at *offset* in *fd* into *out*
+    which is expected to be *size* bytes long once inflated. */
+bool inflateAt( int fd, unsigned long long offset, size_t size,
+    tero::gitObjects::buffer& out )
+{
+    out.resize(size);
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if( inflateInit(&strm) != Z_OK ) return false;
+
+    char chunk[8192];
+    int err = Z_OK;
+    strm.next_out = (Bytef*)(size > 0 ? &out[0] : chunk);
+    strm.avail_out = size;
+    while( err == Z_OK ) {
+        if( strm.avail_in == 0 ) {
+            size_t n = readAt(fd, chunk, sizeof(chunk), offset);
+            if( n == 0 ) break;
+            offset += n;
+            strm.next_in = (Bytef*)chunk;
+            strm.avail_in = n;
+        }
+        if( size == 0 ) {
+            /* zlib needs some room to make progress on an empty stream. */
+            char dummy;
+            strm.next_out = (Bytef*)&dummy;
+            strm.avail_out = 1;
+        }
+        err = inflate(&strm, Z_NO_FLUSH);
+    }
+    bool ok = (err == Z_STREAM_END && strm.total_out == size);
+    inflateEnd(&strm);
+    return ok;
+}
+
+
+/** Inflates a complete zlib stream held in memory. */
+bool inflateAll( const tero::gitObjects::buffer& in,
+    tero::gitObjects::buffer& out )
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if( inflateInit(&strm) != Z_OK ) return false;
+    strm.next_in = (Bytef*)(in.empty() ? NULL : &in[0]);
+    strm.avail_in = in.size();
+
+    out.clear();
+    char chunk[16384];
+    int err = Z_OK;
+    while( err == Z_OK ) {
+        strm.next_out = (Bytef*)chunk;
+        strm.avail_out = sizeof(chunk);
+        err = inflate(&strm, Z_NO_FLUSH);
+        out.insert(out.end(), chunk, chunk + (sizeof(chunk) - strm.avail_out));
+        if( err == Z_BUF_ERROR && strm.avail_in == 0 ) break;
+    }
+    inflateEnd(&strm);
+    return err == Z_STREAM_END;
+}
+
+
+/** Reads a base-128 size as encoded in delta headers. */
+bool deltaSize( const char*& p, const char *last, size_t& size ) {
+    size = 0;
+    int shift = 0;
+    unsigned char c;
+    do {
+        if( p == last || shift > 56 ) return false;
+        c = *p++;
+        size |= (size_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while( c & 0x80 );
+    return true;
+}
+
+
+/** Rebuilds an object out of its *base* and a *delta*. */
+bool applyDelta( const tero::gitObjects::buffer& base,
+    const tero::gitObjects::buffer& delta,
+    tero::gitObjects::buffer& result )
+{
+    const char *p = delta.empty() ? NULL : &delta[0];
+    const char *last = p + delta.size();
+    size_t baseSize, resultSize;
+    if( !deltaSize(p, last, baseSize) || baseSize != base.size() ) {
+        return false;
+    }
+    if( !deltaSize(p, last, resultSize) ) return false;
+    result.clear();
+    result.reserve(resultSize);
+    while( p != last ) {
+        unsigned char cmd = *p++;
+        if( cmd & 0x80 ) {
+            /* copy from base */
+            size_t offset = 0, size = 0;
+            for( int i = 0; i < 4; ++i ) {
+                if( cmd & (1 << i) ) {
+                    if( p == last ) return false;
+                    offset |= (size_t)(unsigned char)*p++ << (8 * i);
+                }
+            }
+            for( int i = 0; i < 3; ++i ) {
+                if( cmd & (0x10 << i) ) {
+                    if( p == last ) return false;
+                    size |= (size_t)(unsigned char)*p++ << (8 * i);
+                }
+            }
+            if( size == 0 ) size = 0x10000;
+            if( offset + size > base.size() ) return false;
+            result.insert(result.end(),
+                base.begin() + offset, base.begin() + offset + size);
+        } else if( cmd != 0 ) {
+            /* insert literal bytes */
+            if( (size_t)(last - p) < cmd ) return false;
+            result.insert(result.end(), p, p + cmd);
+            p += cmd;
+        } else {
+            return false;
+        }
+    }
+    return result.size() == resultSize;
+}
+
+}
+
+
+namespace tero {
+
+void gitObjects::clear() {
+    for( packSet::iterator pack = packs.begin(); pack != packs.end(); ++pack ) {
+        if( pack->second->fd >= 0 ) close(pack->second->fd);
+        delete pack->second;
+    }
+    packs.clear();
+}
+
+
+void gitObjects::open( const boost::filesystem::path& dir ) {
+    if( dir != gitdir ) {
+        clear();
+        gitdir = dir;
+    }
+}
+
+
+void gitObjects::scanPacks() {
+    using namespace boost::filesystem;
+
+    boost::system::error_code ec;
+    path packdir = gitdir / "objects" / "pack";
+    for( directory_iterator entry = directory_iterator(packdir, ec);
+         !ec && entry != directory_iterator(); entry.increment(ec) ) {
+        path idxPath = entry->path();
+        if( idxPath.extension() != ".idx"
+            || packs.find(idxPath) != packs.end() ) continue;
+
+        packfile *pack = new packfile();
+        packs[idxPath] = pack;
+        pack->pathname = idxPath;
+        pack->pathname.replace_extension(".pack");
+        size_t idxSize = file_size(idxPath, ec);
+        if( ec || idxSize < 8 + 256 * 4 ) continue;
+        pack->idx.resize(idxSize);
+        ifstream idxFile(idxPath, std::ios_base::in | std::ios_base::binary);
+        if( !idxFile.read(&pack->idx[0], idxSize) ) continue;
+
+        const char *data = &pack->idx[0];
+        size_t fanout = 0;
+        if( memcmp(data, "\377tOc", 4) == 0 ) {
+            if( getBigEndian32(data + 4) != 2 ) continue;
+            pack->version = 2;
+            fanout = 8;
+            pack->count = getBigEndian32(data + fanout + 255 * 4);
+            if( idxSize < fanout + 256 * 4
+                + (size_t)pack->count * (20 + 4 + 4) ) continue;
+        } else {
+            pack->version = 1;
+            pack->count = getBigEndian32(data + 255 * 4);
+            if( idxSize < 256 * 4 + (size_t)pack->count * 24 ) continue;
+        }
+        pack->fd = ::open(pack->pathname.string().c_str(), O_RDONLY);
+        if( pack->fd >= 0 ) {
+            /* Packfiles stay open across forks of --cache workers,
+               not across exec. */
+            fcntl(pack->fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+}
+
+
+bool gitObjects::find( const packfile& pack, const objectId& id,
+    unsigned long long& offset ) const
+{
+    if( pack.fd < 0 || pack.count == 0 ) return false;
+    const char *data = &pack.idx[0];
+    const char *fanout = data + (pack.version == 2 ? 8 : 0);
+    unsigned char first = id[0];
+    unsigned int lo = first > 0 ? getBigEndian32(fanout + (first - 1) * 4) : 0;
+    unsigned int hi = getBigEndian32(fanout + first * 4);
+    if( hi > pack.count ) return false;
+
+    const char *names = fanout + 256 * 4;
+    size_t stride = 20;
+    if( pack.version == 1 ) {
+        names += 4;
+        stride = 24;
+    }
+    while( lo < hi ) {
+        unsigned int mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(names + mid * stride, id.data(), 20);
+        if( cmp == 0 ) {
+            if( pack.version == 1 ) {
+                offset = getBigEndian32(names + mid * stride - 4);
+                return true;
+            }
+            const char *offsets = fanout + 256 * 4
+                + (size_t)pack.count * (20 + 4);
+            unsigned int off = getBigEndian32(offsets + mid * 4);
+            if( off & 0x80000000 ) {
+                /* index into the table of 64-bit offsets */
+                const char *large = offsets + (size_t)pack.count * 4
+                    + (size_t)(off & 0x7fffffff) * 8;
+                if( large + 8 > data + pack.idx.size() ) return false;
+                offset = ((unsigned long long)getBigEndian32(large) << 32)
+                    | getBigEndian32(large + 4);
+            } else {
+                offset = off;
+            }
+            return true;
+        }
+        if( cmp < 0 ) lo = mid + 1;
+        else hi = mid;
+    }
+    return false;
+}
+
+
+gitObjects::objectType
+gitObjects::readLoose( const objectId& id, buffer& data )
+{
+    using namespace boost::filesystem;
+
+    std::string name = hex(id);
+    path pathname = gitdir / "objects" / name.substr(0, 2) / name.substr(2);
+    boost::system::error_code ec;
+    size_t size = file_size(pathname, ec);
+    if( ec ) return none;
+
+    buffer compressed(size);
+    ifstream file(pathname, std::ios_base::in | std::ios_base::binary);
+    if( size > 0 && !file.read(&compressed[0], size) ) return none;
+    if( !inflateAll(compressed, data) ) return none;
+
+    /* header is "<type> <size>\0" */
+    buffer::iterator nul = std::find(data.begin(), data.end(), '\0');
+    if( nul == data.end() ) return none;
+    std::string header(data.begin(), nul);
+    size_t sep = header.find(' ');
+    if( sep == std::string::npos ) return none;
+    std::string typeName = header.substr(0, sep);
+    objectType type = none;
+    for( int t = commitObj; t <= tagObj; ++t ) {
+        if( typeName == typeNames[t] ) type = (objectType)t;
+    }
+    if( type == none
+        || strtoul(header.c_str() + sep + 1, NULL, 10)
+        != (size_t)(data.end() - nul - 1) ) {
+        return none;
+    }
+    data.erase(data.begin(), nul + 1);
+    return type;
+}
+
+
+gitObjects::objectType
+gitObjects::readPacked( packfile& pack, unsigned long long offset,
+    buffer& data, int depth )
+{
+    if( depth > maxDeltaDepth ) return none;
+
+    /* object header: type and inflated size, followed by the reference
+       to the base object for deltas. */
+    char header[32];
+    size_t headerSize = readAt(pack.fd, header, sizeof(header), offset);
+    const char *p = header;
+    const char *last = header + headerSize;
+    if( p == last ) return none;
+    unsigned char c = *p++;
+    int type = (c >> 4) & 0x7;
+    size_t size = c & 0x0f;
+    int shift = 4;
+    while( c & 0x80 ) {
+        if( p == last || shift > 56 ) return none;
+        c = *p++;
+        size |= (size_t)(c & 0x7f) << shift;
+        shift += 7;
+    }
+
+    buffer base;
+    objectType baseType = none;
+    if( type == ofsDelta ) {
+        if( p == last ) return none;
+        c = *p++;
+        unsigned long long rel = c & 0x7f;
+        while( c & 0x80 ) {
+            if( p == last ) return none;
+            c = *p++;
+            rel = ((rel + 1) << 7) | (c & 0x7f);
+        }
+        if( rel == 0 || rel > offset ) return none;
+        baseType = readPacked(pack, offset - rel, base, depth + 1);
+    } else if( type == refDelta ) {
+        if( last - p < 20 ) return none;
+        baseType = readObject(objectId(p, 20), base, depth + 1);
+        p += 20;
+    } else if( type < commitObj || type > tagObj ) {
+        return none;
+    }
+    if( (type == ofsDelta || type == refDelta) && baseType == none ) {
+        return none;
+    }
+
+    unsigned long long dataOffset = offset + (p - header);
+    if( baseType == none ) {
+        return inflateAt(pack.fd, dataOffset, size, data) ?
+            (objectType)type : none;
+    }
+    buffer delta;
+    if( !inflateAt(pack.fd, dataOffset, size, delta)
+        || !applyDelta(base, delta, data) ) {
+        return none;
+    }
+    return baseType;
+}
+
+
+gitObjects::objectType
+gitObjects::readObject( const objectId& id, buffer& data, int depth )
+{
+    if( id.size() != 20 || gitdir.empty() ) return none;
+    objectType type = readLoose(id, data);
+    if( type != none ) return type;
+
+    /* The set of packs is scanned again when an object cannot be found
+       in case the repository was repacked since. */
+    for( int pass = 0; pass < 2; ++pass ) {
+        if( pass > 0 || packs.empty() ) scanPacks();
+        for( packSet::iterator pack = packs.begin();
+             pack != packs.end(); ++pack ) {
+            unsigned long long offset;
+            if( find(*pack->second, id, offset) ) {
+                return readPacked(*pack->second, offset, data, depth);
+            }
+        }
+    }
+    return none;
+}
+
+
+gitObjects::objectType
+gitObjects::read( const objectId& id, buffer& data )
+{
+    return readObject(id, data, 0);
+}
+
+
+bool gitObjects::resolveRef( const std::string& ref, objectId& id,
+    int depth )
+{
+    using namespace boost::filesystem;
+
+    if( depth > 5 || ref.empty() || ref.find("..") != std::string::npos ) {
+        return false;
+    }
+    if( unhex(ref, id) ) return true;
+
+    boost::system::error_code ec;
+    if( is_regular_file(gitdir / ref, ec) ) {
+        std::string line;
+        ifstream file(gitdir / ref);
+        std::getline(file, line);
+        if( line.compare(0, 5, "ref: ") == 0 ) {
+            return resolveRef(line.substr(5), id, depth + 1);
+        }
+        return unhex(line, id);
+    }
+    ifstream packed(gitdir / "packed-refs");
+    std::string line;
+    while( std::getline(packed, line) ) {
+        if( line.size() > 41 && line[40] == ' '
+            && line.compare(41, std::string::npos, ref) == 0 ) {
+            return unhex(line.substr(0, 40), id);
+        }
+    }
+    return false;
+}
+
+
+bool gitObjects::resolve( const std::string& rev, objectId& id )
+{
+    static const char *prefixes[] = {
+        "", "refs/", "refs/tags/", "refs/heads/", "refs/remotes/"
+    };
+    if( rev.find_first_of("^~:@{} \t\n") != std::string::npos ) {
+        return false;
+    }
+    for( size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); ++i ) {
+        if( resolveRef(std::string(prefixes[i]) + rev, id, 0) ) return true;
+    }
+    return false;
+}
+
+
+gitObjects::objectType
+gitObjects::locate( const std::string& rev,
+    const boost::filesystem::path& pathname, objectId& id )
+{
+    buffer data;
+    if( !resolve(rev, id) ) return none;
+    objectType type = read(id, data);
+
+    /* peel tags and commits down to the root tree. */
+    while( type == tagObj || type == commitObj ) {
+        const char *key = (type == tagObj) ? "object " : "tree ";
+        size_t keySize = strlen(key);
+        if( data.size() < keySize + 40
+            || !std::equal(key, key + keySize, data.begin())
+            || !unhex(std::string(data.begin() + keySize,
+                    data.begin() + keySize + 40), id) ) {
+            return none;
+        }
+        type = read(id, data);
+    }
+
+    std::vector<std::string> names;
+    for( boost::filesystem::path::const_iterator part = pathname.begin();
+         part != pathname.end(); ++part ) {
+        std::string name = part->string();
+        if( name.empty() || name == "." || name == "/" ) continue;
+        names.push_back(name);
+    }
+    for( std::vector<std::string>::const_iterator name = names.begin();
+         name != names.end(); ++name ) {
+        if( type != treeObj ) return none;
+        treeEntries entries;
+        parseTree(data, entries);
+        treeEntries::const_iterator entry = entries.begin();
+        while( entry != entries.end() && entry->name != *name ) ++entry;
+        if( entry == entries.end() ) return none;
+        id = entry->id;
+        if( name + 1 == names.end() ) {
+            /* The last object is not read, its mode tells its type. */
+            type = entry->isTree() ? treeObj : blobObj;
+        } else {
+            type = read(id, data);
+        }
+    }
+    return type;
+}
+
+
+gitObjects::objectType
+gitObjects::lookup( const std::string& rev,
+    const boost::filesystem::path& pathname, buffer& data )
+{
+    objectId id;
+    if( locate(rev, pathname, id) == none ) return none;
+    return read(id, data);
+}
+
+
+void gitObjects::parseTree( const buffer& data, treeEntries& entries )
+{
+    /* Each entry is "<octal mode> <name>\0<20 bytes id>". */
+    buffer::const_iterator p = data.begin();
+    while( p != data.end() ) {
+        buffer::const_iterator space = std::find(p, data.end(), ' ');
+        buffer::const_iterator nul = std::find(space, data.end(), '\0');
+        if( nul == data.end() || data.end() - nul < 21 ) break;
+        treeEntry entry;
+        entry.mode = strtoul(std::string(p, space).c_str(), NULL, 8);
+        entry.name.assign(space + 1, nul);
+        entry.id.assign(nul + 1, nul + 21);
+        entries.push_back(entry);
+        p = nul + 21;
+    }
+}
+
+
+std::string gitObjects::hex( const objectId& id )
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string result;
+    for( std::string::const_iterator c = id.begin(); c != id.end(); ++c ) {
+        result += digits[(*c >> 4) & 0xf];
+        result += digits[*c & 0xf];
+    }
+    return result;
+}
+
+
+bool gitObjects::unhex( const std::string& text, objectId& id )
+{
+    if( text.size() != 40 ) return false;
+    std::string result;
+    for( size_t i = 0; i < 40; i += 2 ) {
+        int value = 0;
+        for( size_t j = i; j < i + 2; ++j ) {
+            char c = text[j];
+            value <<= 4;
+            if( c >= '0' && c <= '9' ) value |= c - '0';
+            else if( c >= 'a' && c <= 'f' ) value |= c - 'a' + 10;
+            else if( c >= 'A' && c <= 'F' ) value |= c - 'A' + 10;
+            else return false;
+        }
+        result += (char)value;
+    }
+    id = result;
+    return true;
+}
+
+}
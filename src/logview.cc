@@ -29,6 +29,7 @@
 #include "logview.hh"
 #include "markup.hh"
 #include "project.hh"
+#include "feeds.hh"
 
 /** Pages related to logs.
 
@@ -231,43 +232,81 @@ void junitDate( session& s, const url& name )
 }
 
 
-void junitContent( session& s, const slice<char>& text, const url& name )
+namespace {
+
+/** Writes the number of failures, errors and tests in *testsuite*. */
+void junitSummary( session& s, RAPIDXML::xml_node<> *testsuite )
 {
     using namespace RAPIDXML;
 
-    RAPIDXML::xml_document<> *doc = s.loadxml(s.abspath(name));
+    int nbFailures = attrAsInt(testsuite, "failures");
+    int nbErrors = attrAsInt(testsuite, "errors");
+    int nbTests = attrAsInt(testsuite, "tests");
 
-    xml_node<> *testsuite = doc->first_node();
-    if( testsuite != NULL ) {
-        int nbFailures = attrAsInt(testsuite, "failures");
-        int nbErrors = attrAsInt(testsuite, "errors");
-        int nbTests = attrAsInt(testsuite, "tests");
-
-        if( (nbErrors + nbFailures) > 0  ) {
-            const char *sep = "";
-            if( nbFailures > 0 ) {
-                s.out() << nbFailures << " failures" << std::endl;
-                sep = ",";
-            }
-            if( nbErrors > 0 ) {
-                s.out() << nbErrors << " errors" << std::endl;
-            }
-            s.out() << " out of " << nbTests << " tests." << std::endl;
-        } else {
-            s.out() << nbTests << " tests passed." << std::endl;
+    if( (nbErrors + nbFailures) > 0  ) {
+        const char *sep = "";
+        if( nbFailures > 0 ) {
+            s.out() << nbFailures << " failures" << std::endl;
+            sep = ",";
         }
+        if( nbErrors > 0 ) {
+            s.out() << nbErrors << " errors" << std::endl;
+        }
+        s.out() << " out of " << nbTests << " tests." << std::endl;
+    } else {
+        s.out() << nbTests << " tests passed." << std::endl;
+    }
 
-        for( xml_node<> *testcase = testsuite->first_node("testcase");
-             testcase != NULL; testcase = testcase->next_sibling("testcase") ) {
-            xml_attribute<> *name = testcase->first_attribute("name");
-            if( name ) {
-                // XXX implement: output testcase if failed.
-                // std::cerr << "testcase: " << name->value() << std::endl;
-            }
+    for( xml_node<> *testcase = testsuite->first_node("testcase");
+         testcase != NULL; testcase = testcase->next_sibling("testcase") ) {
+        xml_attribute<> *name = testcase->first_attribute("name");
+        if( name ) {
+            // XXX implement: output testcase if failed.
+            // std::cerr << "testcase: " << name->value() << std::endl;
         }
     }
+}
 
-    if( doc ) delete doc;
+}  // anonymous
+
+
+void junitContent( session& s, const slice<char>& text, const url& name )
+{
+    /* The document is owned by the session. */
+    RAPIDXML::xml_document<> *doc = s.loadxml(s.abspath(name));
+    RAPIDXML::xml_node<> *testsuite = doc ? doc->first_node() : NULL;
+    if( testsuite != NULL ) {
+        junitSummary(s,testsuite);
+    }
+}
+
+
+void junitPost( session& s, post& p, const url& name )
+{
+    boost::filesystem::path pathname = s.abspath(name);
+    RAPIDXML::xml_document<> *doc = s.loadxml(pathname);
+    RAPIDXML::xml_node<> *testsuite = doc ? doc->first_node() : NULL;
+
+    p.title = fileTitle(s,name);
+    p.author = fileAuthor(s,pathname);
+    p.time = fileTime(pathname);
+    std::string text;
+    if( testsuite != NULL ) {
+        try {
+            boost::posix_time::ptime time
+                = attrAsDate(testsuite, "timestamp");
+            if( !time.is_not_a_date_time() ) p.time = time;
+        } catch( std::exception& e ) {
+            std::cerr << "error: unable to reconstruct time from "
+                      << pathname << std::endl;
+        }
+        captureOutput content(s);
+        junitSummary(s,testsuite);
+        text = content.str();
+    } else {
+        text = s.asUrl(pathname).string();
+    }
+    p.content.adopt(text);
 }
 
 
@@ -321,6 +360,7 @@ void logviewFetch( session& s, const url& name )
             pathname : siteTop.value(s) / "log");
 
         std::string logBase;
+        s.depends(dirname);
         for( directory_iterator entry = directory_iterator(dirname);
              entry != directory_iterator(); ++entry ) {
             boost::smatch m;
@@ -410,6 +450,7 @@ void writeLogSummaries( session& s, const url& name )
         base.remove_leaf();
     }
 
+    s.depends(base);
     for( directory_iterator entry = directory_iterator(base);
          entry != directory_iterator(); ++entry ) {
         boost::smatch m;
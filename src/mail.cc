@@ -197,9 +197,14 @@ void mailAsPost::token( rfc2822Token token, const char *line,
             constructed.score = atoi(value.c_str());
             break;
         default: {
-            if( name.compare(0, 16, "x-Profile-Google") == 0 ) {
+            if( name.compare(0, 16, "x-Profile-Google") == 0
+                && constructed.author ) {
+                /* Interned contributors are shared between posts. */
+                constructed.author.reset(new contrib(*constructed.author));
                 constructed.author->google = value;
-            } else if( name.compare(0, 18, "x-Profile-Linkedin") == 0 ) {
+            } else if( name.compare(0, 18, "x-Profile-Linkedin") == 0
+                && constructed.author ) {
+                constructed.author.reset(new contrib(*constructed.author));
                 constructed.author->linkedin = value;
             } else {
                 post::headersMap::iterator header
@@ -215,7 +220,7 @@ void mailAsPost::token( rfc2822Token token, const char *line,
     } break;
     case rfc2822MessageBody:
         nontrivial = true;
-        constructed.content = std::string(&line[first],&line[last]);
+        constructed.content = sharedText(&line[first],&line[last]);
         break;
     default:
         /* to stop gcc from complaining */
@@ -237,7 +242,8 @@ mailParser::addFile( session& s, const boost::filesystem::path& filename ) const
         start += processed;
         length -= processed;
         if( listener.nontrivial ) {
-            post entry = listener.unserialized();
+            post entry;
+            listener.unserialized(entry);
             entry.filename = filename;
             entry.guid = s.asUrl(filename).string();
             filter->filters(entry);
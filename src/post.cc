@@ -78,6 +78,20 @@ bool post::valid() const {
 }
 
 
+void post::swap( post& p ) {
+    author.swap(p.author);
+    std::swap(time,p.time);
+    content.swap(p.content);
+    std::swap(link,p.link);
+    title.swap(p.title);
+    guid.swap(p.guid);
+    filename.swap(p.filename);
+    std::swap(score,p.score);
+    tag.swap(p.tag);
+    moreHeaders.swap(p.moreHeaders);
+}
+
+
 void passThruFilter::flush() {
     if( next ) next->flush();
 }
@@ -30,6 +30,7 @@
 #include "revsys.hh"
 #include "decorator.hh"
 #include "contrib.hh"
+#include "feeds.hh"
 
 /** Pages related to projects
 
@@ -94,6 +95,16 @@ void projectTitle( session& s, const url& name )
 }
 
 
+void projectPost( session& s, post& p, const url& name )
+{
+    boost::filesystem::path pathname = s.abspath(name);
+    p.title = projectName(s,pathname);
+    p.author = fileAuthor(s,pathname);
+    p.time = fileTime(pathname);
+    postContent(s,p,name);
+}
+
+
 void projindexFetch( session& s, const slice<char>& text, const url& name )
 {
     using namespace RAPIDXML;
@@ -158,6 +169,7 @@ void projindexFetch( session& s, const slice<char>& text, const url& name )
                 path dirname(siteTop.value(s) / std::string(*d));
                 path prefix(dirname / std::string(projname->value()));
                 if( boost::filesystem::exists(dirname) ) {
+                    s.depends(dirname);
                     for( directory_iterator entry = directory_iterator(dirname); 
                          entry != directory_iterator(); ++entry ) {
                         path p(*entry);
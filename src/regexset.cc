@@ -0,0 +1,472 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include <algorithm>
+#include <cctype>
+#include "regexset.hh"
+
+/** Match a string against an ordered set of regular expressions
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace tero {
+
+/** Recursive descent parser for the subset of the perl syntax
+    supported by regexSet.
+*/
+class regexSet::parser {
+protected:
+    const std::string pat;
+    size_t pos;
+    int depth;
+
+    bool atEnd() const { return pos >= pat.size(); }
+
+    static void escapeClass( charSet& accepts, char c ) {
+        charSet cls;
+        switch( tolower(c) ) {
+        case 'd':
+            for( int i = '0'; i <= '9'; ++i ) cls.set(i);
+            break;
+        case 'w':
+            for( int i = 0; i < 128; ++i ) {
+                if( isalnum(i) || i == '_' ) cls.set(i);
+            }
+            break;
+        case 's':
+            cls.set(' ').set('\t').set('\n').set('\v').set('\f').set('\r');
+            break;
+        }
+        if( isupper(c) ) cls.flip();
+        accepts |= cls;
+    }
+
+    /** Parses the character following a backslash and adds the set
+        of characters it stands for to *accepts*. */
+    bool escape( charSet& accepts ) {
+        if( atEnd() ) return false;
+        char c = pat[pos++];
+        switch( c ) {
+        case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+            escapeClass(accepts,c);
+            return true;
+        case 'n': accepts.set('\n'); return true;
+        case 't': accepts.set('\t'); return true;
+        case 'r': accepts.set('\r'); return true;
+        case 'f': accepts.set('\f'); return true;
+        case 'v': accepts.set('\v'); return true;
+        default:
+            if( isalnum((unsigned char)c) ) {
+                /* back references, assertions, hexadecimal codes, etc. */
+                return false;
+            }
+            accepts.set((unsigned char)c);
+        }
+        return true;
+    }
+
+    bool charClass( node& n ) {
+        bool negate = false;
+        if( !atEnd() && pat[pos] == '^' ) {
+            negate = true;
+            ++pos;
+        }
+        bool first = true;
+        while( !atEnd() && (pat[pos] != ']' || first) ) {
+            first = false;
+            int low;
+            if( pat[pos] == '[' && pos + 1 < pat.size()
+                && (pat[pos + 1] == ':' || pat[pos + 1] == '='
+                    || pat[pos + 1] == '.') ) {
+                /* POSIX classes, collating elements */
+                return false;
+            }
+            if( pat[pos] == '\\' ) {
+                ++pos;
+                if( atEnd() ) return false;
+                char c = pat[pos];
+                if( c == 'd' || c == 'D' || c == 'w' || c == 'W'
+                    || c == 's' || c == 'S' ) {
+                    ++pos;
+                    escapeClass(n.accepts,c);
+                    continue;
+                }
+                charSet single;
+                if( !escape(single) || single.count() != 1 ) return false;
+                low = 0;
+                while( !single.test(low) ) ++low;
+            } else {
+                low = (unsigned char)pat[pos++];
+            }
+            int high = low;
+            if( pos + 1 < pat.size() && pat[pos] == '-' && pat[pos + 1] != ']' ) {
+                ++pos;
+                if( pat[pos] == '\\' ) {
+                    ++pos;
+                    charSet single;
+                    if( !escape(single) || single.count() != 1 ) return false;
+                    high = 0;
+                    while( !single.test(high) ) ++high;
+                } else {
+                    high = (unsigned char)pat[pos++];
+                }
+                if( high < low ) return false;
+            }
+            for( int i = low; i <= high; ++i ) n.accepts.set(i);
+        }
+        if( atEnd() ) return false;
+        ++pos; /* ']' */
+        if( negate ) n.accepts.flip();
+        return true;
+    }
+
+    bool atom( node& n ) {
+        char c = pat[pos++];
+        switch( c ) {
+        case '(':
+            if( !atEnd() && pat[pos] == '?' ) {
+                if( pos + 1 < pat.size() && pat[pos + 1] == ':' ) {
+                    pos += 2;
+                } else {
+                    /* look-aheads, independent sub-expressions, etc. */
+                    return false;
+                }
+            }
+            ++depth;
+            if( !alternate(n) ) return false;
+            --depth;
+            if( atEnd() || pat[pos] != ')' ) return false;
+            ++pos;
+            return true;
+        case '[':
+            n.kind = node::chars;
+            return charClass(n);
+        case '.':
+            n.kind = node::chars;
+            n.accepts.set();
+            return true;
+        case '\\':
+            n.kind = node::chars;
+            return escape(n.accepts);
+        case '^':
+            /* regex_match always anchors the match at the begining
+               of the input. */
+            n.kind = node::empty;
+            return pos == 1;
+        case '$':
+            /* ... and at the end of the input. */
+            n.kind = node::empty;
+            return pos == pat.size() && depth == 0;
+        case ')': case '|': case '*': case '+': case '?': case '{': case ']':
+            return false;
+        default:
+            n.kind = node::chars;
+            n.accepts.set((unsigned char)c);
+        }
+        return true;
+    }
+
+    bool number( int& v ) {
+        if( atEnd() || !isdigit((unsigned char)pat[pos]) ) return false;
+        v = 0;
+        while( !atEnd() && isdigit((unsigned char)pat[pos]) ) {
+            v = v * 10 + (pat[pos++] - '0');
+        }
+        return true;
+    }
+
+    bool quantifier( node& n ) {
+        int minRepeat = 1, maxRepeat = 1;
+        switch( pat[pos] ) {
+        case '*':
+            minRepeat = 0; maxRepeat = -1;
+            ++pos;
+            break;
+        case '+':
+            minRepeat = 1; maxRepeat = -1;
+            ++pos;
+            break;
+        case '?':
+            minRepeat = 0; maxRepeat = 1;
+            ++pos;
+            break;
+        case '{':
+            ++pos;
+            if( !number(minRepeat) ) return false;
+            maxRepeat = minRepeat;
+            if( !atEnd() && pat[pos] == ',' ) {
+                ++pos;
+                maxRepeat = -1;
+                if( !atEnd() && pat[pos] != '}' && !number(maxRepeat) ) {
+                    return false;
+                }
+            }
+            if( atEnd() || pat[pos] != '}' ) return false;
+            ++pos;
+            if( maxRepeat >= 0 && maxRepeat < minRepeat ) return false;
+            break;
+        }
+        if( !atEnd() ) {
+            if( pat[pos] == '?' ) {
+                /* Non-greedy repeats match the same set of strings. */
+                ++pos;
+            } else if( pat[pos] == '+' ) {
+                /* Possessive repeats do not. */
+                return false;
+            }
+        }
+        node child(n);
+        n = node(node::repeat);
+        n.children.push_back(child);
+        n.minRepeat = minRepeat;
+        n.maxRepeat = maxRepeat;
+        return true;
+    }
+
+    bool concat( node& n ) {
+        n = node(node::concat);
+        while( !atEnd() && pat[pos] != '|' && pat[pos] != ')' ) {
+            node item;
+            if( !atom(item) ) return false;
+            while( !atEnd() && (pat[pos] == '*' || pat[pos] == '+'
+                    || pat[pos] == '?' || pat[pos] == '{') ) {
+                if( !quantifier(item) ) return false;
+            }
+            n.children.push_back(item);
+        }
+        return true;
+    }
+
+public:
+    explicit parser( const std::string& p ) : pat(p), pos(0), depth(0) {}
+
+    bool alternate( node& n ) {
+        n = node(node::alternate);
+        while( true ) {
+            node item;
+            if( !concat(item) ) return false;
+            n.children.push_back(item);
+            if( atEnd() || pat[pos] != '|' ) break;
+            ++pos;
+        }
+        return true;
+    }
+
+    bool parse( node& n ) {
+        return alternate(n) && atEnd();
+    }
+};
+
+
+regexSet::regexSet()
+    : valid(true), nbPatterns(0), nfaStart(0)
+{
+    nfa.push_back(nfaState());
+}
+
+
+int regexSet::compile( const node& n, int next )
+{
+    switch( n.kind ) {
+    case node::chars: {
+        nfaState s;
+        s.epsilon = false;
+        s.accepts = n.accepts;
+        s.outs.push_back(next);
+        nfa.push_back(s);
+        return nfa.size() - 1;
+    }
+    case node::concat:
+        for( std::vector<node>::const_reverse_iterator
+                 child = n.children.rbegin();
+             child != n.children.rend(); ++child ) {
+            next = compile(*child,next);
+        }
+        return next;
+    case node::alternate: {
+        std::vector<int> outs;
+        for( std::vector<node>::const_iterator child = n.children.begin();
+             child != n.children.end(); ++child ) {
+            outs.push_back(compile(*child,next));
+        }
+        nfa.push_back(nfaState());
+        nfa.back().outs = outs;
+        return nfa.size() - 1;
+    }
+    case node::repeat: {
+        const node& child = n.children.front();
+        if( n.maxRepeat < 0 ) {
+            /* loop back through an epsilon state. */
+            nfa.push_back(nfaState());
+            int loop = nfa.size() - 1;
+            int body = compile(child,loop);
+            nfa[loop].outs.push_back(body);
+            nfa[loop].outs.push_back(next);
+            next = loop;
+        } else {
+            for( int i = n.minRepeat; i < n.maxRepeat; ++i ) {
+                int body = compile(child,next);
+                nfa.push_back(nfaState());
+                nfa.back().outs.push_back(body);
+                nfa.back().outs.push_back(next);
+                next = nfa.size() - 1;
+            }
+        }
+        for( int i = 0; i < n.minRepeat; ++i ) {
+            next = compile(child,next);
+        }
+        return next;
+    }
+    default:
+        break;
+    }
+    return next;
+}
+
+
+bool regexSet::add( const boost::regex& pat )
+{
+    if( !valid ) return false;
+
+    node root;
+    parser p(pat.str());
+    if( pat.flags() != boost::regex::normal || !p.parse(root) ) {
+        valid = false;
+        return false;
+    }
+    nfaState accept;
+    accept.pattern = nbPatterns++;
+    nfa.push_back(accept);
+    int start = compile(root,nfa.size() - 1);
+    nfa[nfaStart].outs.push_back(start);
+
+    /* The previously built DFA states are obsolete. */
+    dfa.clear();
+    dfaNext.clear();
+    dfaIds.clear();
+    return true;
+}
+
+
+void regexSet::closure( std::vector<int>& states, int s,
+    std::vector<bool>& visited ) const
+{
+    if( visited[s] ) return;
+    visited[s] = true;
+    const nfaState& st = nfa[s];
+    if( st.epsilon && st.pattern < 0 ) {
+        for( std::vector<int>::const_iterator out = st.outs.begin();
+             out != st.outs.end(); ++out ) {
+            closure(states,*out,visited);
+        }
+    } else {
+        states.push_back(s);
+    }
+}
+
+
+int regexSet::state( std::vector<int>& states ) const
+{
+    std::sort(states.begin(),states.end());
+    dfaIndex::const_iterator found = dfaIds.find(states);
+    if( found != dfaIds.end() ) return found->second;
+
+    dfaState d;
+    d.nfaStates = states;
+    d.pattern = -1;
+    for( std::vector<int>::const_iterator s = states.begin();
+         s != states.end(); ++s ) {
+        if( nfa[*s].pattern >= 0
+            && (d.pattern < 0 || nfa[*s].pattern < d.pattern) ) {
+            d.pattern = nfa[*s].pattern;
+        }
+    }
+    dfa.push_back(d);
+    dfaNext.resize(dfa.size() * 256,unknownState);
+    dfaIds[states] = dfa.size() - 1;
+    return dfa.size() - 1;
+}
+
+
+void regexSet::start() const
+{
+    std::vector<int> states;
+    std::vector<bool> visited(nfa.size(),false);
+    closure(states,nfaStart,visited);
+    state(states);
+}
+
+
+int regexSet::transition( int from, unsigned char c ) const
+{
+    std::vector<int> states;
+    std::vector<bool> visited(nfa.size(),false);
+    const std::vector<int>& current = dfa[from].nfaStates;
+    for( std::vector<int>::const_iterator s = current.begin();
+         s != current.end(); ++s ) {
+        const nfaState& st = nfa[*s];
+        if( !st.epsilon && st.accepts.test(c) ) {
+            closure(states,st.outs.front(),visited);
+        }
+    }
+    if( states.empty() ) {
+        dfaNext[from * 256 + c] = deadState;
+        return deadState;
+    }
+    if( dfa.size() >= maxDfaStates ) {
+        /* Bound the memory used by pathological expressions. The start
+           state is rebuilt first such that it remains at index 0. */
+        dfa.clear();
+        dfaNext.clear();
+        dfaIds.clear();
+        start();
+        from = deadState;
+    }
+    int to = state(states);
+    if( from >= 0 ) dfaNext[from * 256 + c] = to;
+    return to;
+}
+
+
+int regexSet::match( const std::string& value ) const
+{
+    if( !valid ) return -1;
+
+    if( dfa.empty() ) start();
+    int current = 0;
+    for( std::string::const_iterator c = value.begin();
+         c != value.end(); ++c ) {
+        int next = dfaNext[current * 256 + (unsigned char)*c];
+        if( next == unknownState ) {
+            next = transition(current,*c);
+        }
+        if( next == deadState ) return -1;
+        current = next;
+    }
+    return dfa[current].pattern;
+}
+
+}
@@ -23,8 +23,14 @@
    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <boost/checked_delete.hpp>
 #include "changelist.hh"
 #include "markup.hh"
 #include <boost/regex.hpp>
@@ -33,6 +39,8 @@
 #include "project.hh"
 #include "revsys.hh"
 #include "decorator.hh"
+#include "commitlog.hh"
+#include "gitobjects.hh"
 #include "popen_streambuf.h"
 
 /** Execute git commands
@@ -43,6 +51,7 @@
 namespace tero {
 
 extern pathVariable binDir;
+extern pathVariable logIndexDir;
 
 /** interaction with a git repository.
  */
@@ -56,6 +65,22 @@ protected:
     */
     std::streambuf* shellcmd( const std::string& cmdline );
 
+    /** Reads blobs and trees in-process. Commands that cannot be
+        answered from the object database are run through git. */
+    gitObjects objects;
+
+    gitObjects::objectType lookup( const boost::filesystem::path& pathname,
+        const std::string& commit, gitObjects::buffer& data );
+
+    typedef std::map<boost::filesystem::path,commitLog*> logSet;
+
+    /** commit indices of the repositories seen so far */
+    logSet logs;
+
+    /** returns the commit index of the repository, updated to HEAD,
+        or NULL if the object database cannot be read. */
+    const commitLog* log( const session& s );
+
     static gitcmd _instance;
 
 public:
@@ -72,11 +97,6 @@ public:
         const boost::filesystem::path& pathname,
         postFilter& filter );
 
-    void diff( std::ostream& ostr,
-        const std::string& leftCommit,
-        const std::string& rightCommit,
-        const boost::filesystem::path& pathname );
-
     void history( std::ostream& ostr,
         const session& s,
         const boost::filesystem::path& pathname,
@@ -90,11 +110,14 @@ public:
         const std::string& commit,
         decorator *dec = NULL );
 
-    slice<char> loadtext( const boost::filesystem::path& pathname,
+    sharedSlice<char> loadtext( const boost::filesystem::path& pathname,
         const std::string& commit );
 
     std::streambuf* openfile( const boost::filesystem::path& pathname,
         const std::string& commit = "HEAD" );
+
+    std::string contentId( const boost::filesystem::path& pathname,
+        const std::string& commit );
 };
 
 
@@ -125,11 +148,6 @@ public:
 
     virtual void commit( const std::string& msg ) {}
 
-    virtual void diff( std::ostream& ostr,
-        const std::string& leftCommit,
-        const std::string& rightCommit,
-        const boost::filesystem::path& pathname ) {}
-
     virtual void history( std::ostream& ostr,
         const session& s,
         const boost::filesystem::path& pathname,
@@ -149,7 +167,11 @@ public:
         const std::string& commit,
         decorator *dec = NULL ) {}
 
-    slice<char> loadtext( const boost::filesystem::path& pathname,
+    /** Files of at least *mapThreshold* bytes are mapped in memory
+        by loadtext instead of being copied into a buffer. */
+    static size_t mapThreshold;
+
+    sharedSlice<char> loadtext( const boost::filesystem::path& pathname,
         const std::string& commit );
 
     std::streambuf* openfile( const boost::filesystem::path& pathname,
@@ -160,6 +182,7 @@ public:
 
 gitcmd gitcmd::_instance;
 filesys filesys::_instance;
+size_t filesys::mapThreshold = 16 * 1024;
 
 
 const std::string nullString;
@@ -250,6 +273,7 @@ revisionsys::exists( session& s, const boost::filesystem::path& dirname ) {
         }
 
         if( !repoRoot.empty() ) {
+            s.depends(repoRoot);
             (*r)->rootpath = repoRoot;
             (*r)->loadconfig(s);
             return *r;
@@ -310,6 +334,7 @@ std::streambuf* revisionsys::findRevOpenfile(
 {
     static const std::string head("HEAD");
     if( boost::filesystem::exists(pathname) ) {
+        s.depends(pathname);
         return filesys::instance().openfile(pathname, head);
     } else {
         revisionsys* rev = findRev(s, pathname);
@@ -325,12 +350,36 @@ std::streambuf* revisionsys::findRevOpenfile(
 }
 
 
-slice<char> revisionsys::loadtext(
+std::string revisionsys::findRevContentId(
     session& s,
     const boost::filesystem::path& pathname )
 {
     static const std::string head("HEAD");
     if( boost::filesystem::exists(pathname) ) {
+        return std::string("fs:") + stamp(pathname);
+    } else {
+        revisionsys* rev = findRev(s, pathname);
+        if( rev ) {
+            std::string id;
+            if( strncmp(rev->metadir, "fs", 2) != 0 ) {
+                id = rev->contentId(rev->relative(pathname), head);
+            } else {
+                id = rev->contentId(pathname, head);
+            }
+            if( !id.empty() ) return rev->metadir + (":" + id);
+        }
+    }
+    return std::string();
+}
+
+
+sharedSlice<char> revisionsys::loadtext(
+    session& s,
+    const boost::filesystem::path& pathname )
+{
+    static const std::string head("HEAD");
+    if( boost::filesystem::exists(pathname) ) {
+        s.depends(pathname);
         return filesys::instance().loadtext(pathname, head);
     } else {
         revisionsys* rev = findRev(s, pathname);
@@ -342,7 +391,52 @@ slice<char> revisionsys::loadtext(
             }
         }
     }
-    return slice<char>();
+    return sharedSlice<char>();
+}
+
+
+std::string revisionsys::stamp( const boost::filesystem::path& pathname )
+{
+    using namespace boost::filesystem;
+
+    boost::system::error_code ec;
+    if( is_directory(pathname / "objects",ec)
+        && is_regular_file(pathname / "HEAD",ec) ) {
+        /* metadir of a git repository */
+        std::string ref;
+        {
+            ifstream head(pathname / "HEAD");
+            std::getline(head,ref);
+        }
+        if( ref.compare(0,5,"ref: ") != 0 ) {
+            /* detached HEAD */
+            return ref;
+        }
+        ref = ref.substr(5);
+        std::string commit;
+        ifstream loose(pathname / ref);
+        if( std::getline(loose,commit) ) {
+            return commit;
+        }
+        ifstream packed(pathname / "packed-refs");
+        std::string line;
+        while( std::getline(packed,line) ) {
+            if( line.size() > 41 && line[40] == ' '
+                && line.compare(41,std::string::npos,ref) == 0 ) {
+                return line.substr(0,40);
+            }
+        }
+        return ref;
+    }
+
+    std::time_t mtime = last_write_time(pathname,ec);
+    if( ec ) return "-";
+    std::stringstream result;
+    result << mtime;
+    if( is_regular_file(pathname,ec) ) {
+        result << ':' << file_size(pathname,ec);
+    }
+    return result.str();
 }
 
 
@@ -373,19 +467,51 @@ std::streambuf* gitcmd::shellcmd( const std::string& cmdline )
 }
 
 
-void gitcmd::diff( std::ostream& ostr,
-    const std::string& leftCommit,
-    const std::string& rightCommit,
-    const boost::filesystem::path& pathname ) {
+gitObjects::objectType gitcmd::lookup(
+    const boost::filesystem::path& pathname,
+    const std::string& commit, gitObjects::buffer& data )
+{
+    objects.open(rootpath);
+    return objects.lookup(commit, pathname, data);
+}
 
-    std::stringstream cmd;
-    cmd << " diff " << leftCommit << " " << rightCommit << " " << pathname;
-    std::istream strm(shellcmd(cmd.str()));
-    while( !strm.eof() ) {
-        std::string line;
-        std::getline(strm, line);
-        ostr << line;
+
+const commitLog* gitcmd::log( const session& s )
+{
+    using namespace boost::filesystem;
+
+    /* Without *logIndexDir*, indices are stored alongside
+       the session files. */
+    path dir;
+    session::variables::const_iterator look = s.find(logIndexDir.name);
+    if( s.found(look) && !look->second.value.empty() ) {
+        dir = logIndexDir.value(s);
+    } else {
+        dir = s.stateDir() / "logs";
+    }
+    std::string name = rootpath.string();
+    std::replace(name.begin(), name.end(), '/', '_');
+    path indexPath = dir / name;
+
+    commitLog *index = NULL;
+    logSet::const_iterator found = logs.find(rootpath);
+    if( found != logs.end() ) {
+        index = found->second;
+    } else {
+        index = new commitLog();
+        index->load(indexPath);
+        logs[rootpath] = index;
     }
+
+    bool changed = false;
+    objects.open(rootpath);
+    if( !index->update(objects, changed) ) return NULL;
+    if( changed && !index->save(indexPath) ) {
+        /* The index is still used for this process. */
+        std::cerr << "warning: cannot save commit index " << indexPath
+                  << std::endl;
+    }
+    return index;
 }
 
 
@@ -394,6 +520,22 @@ void gitcmd::history( std::ostream& ostr,
     const boost::filesystem::path& abspath,
     historyref& ref ) {
 
+    const commitLog *index = log(s);
+    if( index ) {
+        std::string relpath = relative(abspath).string();
+        if( relpath == "." ) relpath = "";
+        commitLog::entryRefs commits;
+        index->history(relpath, commits);
+        for( commitLog::entryRefs::const_iterator
+                 c = commits.begin(); c != commits.end(); ++c ) {
+            ostr << html::a().href(ref.asUrl(s.asUrl(abspath).string(),
+                    (*c)->id).string()).title((*c)->title())
+                 << (*c)->id.substr(0,10) << "..."
+                 << html::a::end << "<br />";
+        }
+        return;
+    }
+
     /* The git command needs to be issued from within a directory
        where the git config can be found by walking up the tree structure. */
     boost::filesystem::initial_path();
@@ -452,8 +594,65 @@ void gitcmd::checkins( const session& s,
     url base = s.asUrl(absolute(""));
 
     /* shows only the last 2 commits */
+    const size_t nbCommits = 2;
+    const commitLog *index = log(s);
+    if( index ) {
+        for( size_t i = 0;
+             i < index->entries().size() && i < nbCommits; ++i ) {
+            const commitLog::entry *c = &index->entries()[i];
+            post ci;
+            std::stringstream guid;
+            guid << base << "commit/" << c->id;
+            ci.guid = guid.str();
+            ci.author = contrib::find(c->authorEmail, c->authorName);
+            ci.time = boost::posix_time::from_time_t(c->time);
+
+            std::stringstream descr, link, title;
+            link << projectName(s, rootpath)
+                 << " &nbsp;&mdash;&nbsp; "
+                 << html::a().href(ci.guid)
+                 << basename(path(ci.guid))
+                 << html::a::end << "<br />";
+            std::istringstream message(c->message);
+            std::string line;
+            while( std::getline(message, line) ) {
+                if( line.empty() ) continue;
+                size_t maxTitleLength = 80;
+                if( title.str().size() < maxTitleLength ) {
+                    size_t remain = (maxTitleLength - title.str().size());
+                    if( line.size() > remain ) {
+                        title << strip(line.substr(0,remain)) << "...";
+                    } else {
+                        title << strip(line);
+                    }
+                }
+                descr << "    " << line << std::endl;
+            }
+            bool firstFile = true;
+            for( std::vector<std::string>::const_iterator
+                     file = c->paths.begin(); file != c->paths.end(); ++file ) {
+                /* directories recorded for merges end with a '/'. */
+                if( (*file)[file->size() - 1] == '/' ) continue;
+                if( firstFile ) {
+                    descr << html::pre();
+                    firstFile = false;
+                }
+                writelink(descr,base.pathname,boost::filesystem::path(*file));
+                descr << std::endl;
+            }
+            if( !firstFile ) descr << html::pre::end;
+
+            ci.link = url(link.str());
+            ci.title = title.str();
+            ci.content = descr.str();
+            ci.normalize();
+            filter.filters(ci);
+        }
+        return;
+    }
+
     std::stringstream sstm;
-    sstm << " log --date=rfc --name-only -2 ";
+    sstm << " log --date=rfc --name-only -" << nbCommits << " ";
 
     bool firstFile = true;
     bool descrStarted = false;
@@ -583,14 +782,32 @@ void gitcmd::show( std::ostream& ostr,
         dec->attach(ostr);
     }
 
-    std::stringstream sstm;
-    sstm << " show " << commit << ":" << pathname;
-    std::istream strm(shellcmd(sstm.str()));
-
-    while( !strm.eof() ) {
-        std::string line;
-        std::getline(strm, line);
-        ostr << line << '\n';
+    gitObjects::buffer data;
+    switch( lookup(pathname, commit, data) ) {
+    case gitObjects::blobObj:
+        if( !data.empty() ) ostr.write(&data[0], data.size());
+        break;
+    case gitObjects::treeObj: {
+        /* same output as git show on a tree. */
+        gitObjects::treeEntries entries;
+        gitObjects::parseTree(data, entries);
+        ostr << "tree " << commit << ":" << pathname.string() << "\n\n";
+        for( gitObjects::treeEntries::const_iterator
+                 entry = entries.begin(); entry != entries.end(); ++entry ) {
+            ostr << entry->name << (entry->isTree() ? "/" : "") << '\n';
+        }
+    } break;
+    default: {
+        std::stringstream sstm;
+        sstm << " show " << commit << ":" << pathname;
+        std::istream strm(shellcmd(sstm.str()));
+
+        while( !strm.eof() ) {
+            std::string line;
+            std::getline(strm, line);
+            ostr << line << '\n';
+        }
+    } break;
     }
 
     if( dec ) {
@@ -600,9 +817,19 @@ void gitcmd::show( std::ostream& ostr,
 }
 
 
-slice<char> gitcmd::loadtext( const boost::filesystem::path& pathname,
+sharedSlice<char> gitcmd::loadtext( const boost::filesystem::path& pathname,
     const std::string& commit )
 {
+    gitObjects::buffer blob;
+    if( lookup(pathname, commit, blob) == gitObjects::blobObj ) {
+        char *text = new char[ blob.size() + 1 ];
+        sharedSlice<char>::storage_type storage(text,
+            boost::checked_array_deleter<char>());
+        std::copy(blob.begin(), blob.end(), text);
+        text[blob.size()] = '\0';
+        return sharedSlice<char>(storage, text, &text[blob.size()]);
+    }
+
     std::vector<char> dyn_buff;
     std::stringstream sstm;
     sstm  << " show " << commit << ":" << pathname;
@@ -619,9 +846,11 @@ slice<char> gitcmd::loadtext( const boost::filesystem::path& pathname,
     }
 
     char *text = new char[ dyn_buff.size() + 1 ];
+    sharedSlice<char>::storage_type storage(text,
+        boost::checked_array_deleter<char>());
     std::copy(dyn_buff.begin(), dyn_buff.end(), text);
     text[dyn_buff.size()] = '\0';
-    return slice<char>(text, &text[dyn_buff.size()]);
+    return sharedSlice<char>(storage, text, &text[dyn_buff.size()]);
 }
 
 
@@ -629,33 +858,135 @@ std::streambuf*
 gitcmd::openfile( const boost::filesystem::path& pathname,
     const std::string& commit )
 {
+    gitObjects::buffer blob;
+    if( lookup(pathname, commit, blob) == gitObjects::blobObj ) {
+        return new std::stringbuf(std::string(blob.begin(), blob.end()),
+            std::ios_base::in);
+    }
     std::stringstream sstm;
     sstm << " show " << commit << ":" << pathname;
     return shellcmd(sstm.str());
 }
 
 
-slice<char> filesys::loadtext( const boost::filesystem::path& pathname,
+std::string gitcmd::contentId( const boost::filesystem::path& pathname,
     const std::string& commit )
 {
+    gitObjects::objectId id;
+    objects.open(rootpath);
+    if( objects.locate(commit, pathname, id) == gitObjects::blobObj ) {
+        return gitObjects::hex(id);
+    }
+    return std::string();
+}
+
+
+namespace {
+
+/** Releases a memory mapping when the last slice into it goes away. */
+struct unmapper {
+    size_t length;
+
+    explicit unmapper( size_t l ) : length(l) {}
+
+    void operator()( char *p ) const {
+        munmap(p, length);
+    }
+};
+
+
+/** Maps *fileSize* bytes of *fd* followed by a '\\0'.
+
+    The mapping is private and writable such that rapidxml can parse
+    the text in place without modifying the file. When the file ends
+    exactly on a page boundary, the file is mapped over an anonymous
+    mapping one page larger so there is room for the terminator.
+    Returns NULL on failure, or when the file was truncated after
+    *fileSize* was read since touching the missing pages would raise
+    SIGBUS.
+*/
+char *mapText( int fd, size_t fileSize, size_t& mapLength )
+{
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    mapLength = ((fileSize + pageSize - 1) / pageSize) * pageSize;
+    char *text = NULL;
+    if( fileSize % pageSize != 0 ) {
+        void *p = mmap(NULL, fileSize, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE, fd, 0);
+        if( p == MAP_FAILED ) return NULL;
+        text = (char*)p;
+    } else {
+        mapLength += pageSize;
+        void *base = mmap(NULL, mapLength, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if( base == MAP_FAILED ) return NULL;
+        if( mmap(base, fileSize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED ) {
+            munmap(base, mapLength);
+            return NULL;
+        }
+        text = (char*)base;
+    }
+    struct stat st;
+    if( fstat(fd, &st) != 0 || (size_t)st.st_size < fileSize ) {
+        munmap(text, mapLength);
+        return NULL;
+    }
+    /* A file that grew since *fileSize* was read has more bytes
+       in the last page. */
+    text[fileSize] = '\0';
+    return text;
+}
+
+}
+
+
+sharedSlice<char> filesys::loadtext( const boost::filesystem::path& pathname,
+    const std::string& commit )
+{
+    using namespace boost::system::errc;
+
 #if 0
     check(pathname);
 #endif
     if( is_regular_file(pathname) ) {
-        size_t fileSize = file_size(pathname);
+        int fd = open(pathname.string().c_str(), O_RDONLY);
+        if( fd < 0 ) {
+            boost::throw_exception(boost::system::system_error(
+                make_error_code(no_such_file_or_directory),pathname.string()));
+        }
+        struct stat st;
+        size_t fileSize = (fstat(fd, &st) == 0) ? st.st_size : 0;
+        if( fileSize >= mapThreshold ) {
+            size_t mapLength;
+            char *text = mapText(fd, fileSize, mapLength);
+            if( text ) {
+                close(fd);
+                sharedSlice<char>::storage_type storage(text,
+                    unmapper(mapLength));
+                return sharedSlice<char>(storage, text, &text[fileSize]);
+            }
+        }
+
+        /* Small files (or mmap failed, or the file was truncated
+           in the meantime): copy into a buffer. */
         char *text = new char[ fileSize + 1 ];
-        std::streambuf *buf = openfile(pathname);
-        if( buf ) {
-            std::istream file(buf);
-            file.read(text, fileSize);
-            delete buf;
+        sharedSlice<char>::storage_type storage(text,
+            boost::checked_array_deleter<char>());
+        size_t total = 0;
+        while( total < fileSize ) {
+            ssize_t n = read(fd, text + total, fileSize - total);
+            if( n < 0 && errno == EINTR ) continue;
+            if( n <= 0 ) break;
+            total += n;
         }
-        text[fileSize] = '\0';
+        close(fd);
         /* +1 for zero but it would arbitrarly augment text -
            does not work for tokenizers. */
-        return slice<char>(text, &text[fileSize]);
+        text[total] = '\0';
+        return sharedSlice<char>(storage, text, &text[total]);
     }
-    return slice<char>();
+    return sharedSlice<char>();
 }
 
 
@@ -0,0 +1,160 @@
+/* Copyright (c) 2009-2013, Fortylines LLC
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+     * Neither the name of fortylines nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY Fortylines LLC ''AS IS'' AND ANY
+   EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL Fortylines LLC BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include "tokenize.hh"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMDSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/** Skip runs of characters that do not need to be processed individually
+    by a tokenizer or decorator.
+
+    Primary Author(s): Sebastien Mirolo <smirolo@fortylines.com>
+*/
+
+namespace {
+
+using namespace tero;
+
+typedef const char *(*scanFunc)( const char *, const char *,
+    const char *, size_t );
+
+/* Vectorized implementations keep one broadcast register per stop
+   character. Sets of stops larger than this are scanned byte by byte. */
+const size_t maxVectorStops = 16;
+
+
+const char *scanScalarFirstOf( const char *first, const char *last,
+    const char *stops, size_t n )
+{
+    for( ; first != last; ++first ) {
+        for( size_t i = 0; i < n; ++i ) {
+            if( *first == stops[i] ) return first;
+        }
+    }
+    return last;
+}
+
+
+#ifdef SIMDSCAN_X86
+
+__attribute__((target("sse2")))
+const char *scanSSE2FirstOf( const char *first, const char *last,
+    const char *stops, size_t n )
+{
+    if( n > maxVectorStops ) return scanScalarFirstOf(first,last,stops,n);
+    __m128i needles[maxVectorStops];
+    for( size_t i = 0; i < n; ++i ) needles[i] = _mm_set1_epi8(stops[i]);
+    while( last - first >= 16 ) {
+        __m128i block = _mm_loadu_si128((const __m128i*)first);
+        __m128i found = _mm_setzero_si128();
+        for( size_t i = 0; i < n; ++i ) {
+            found = _mm_or_si128(found,_mm_cmpeq_epi8(block,needles[i]));
+        }
+        int mask = _mm_movemask_epi8(found);
+        if( mask != 0 ) return first + __builtin_ctz(mask);
+        first += 16;
+    }
+    return scanScalarFirstOf(first,last,stops,n);
+}
+
+
+__attribute__((target("avx2")))
+const char *scanAVX2FirstOf( const char *first, const char *last,
+    const char *stops, size_t n )
+{
+    if( n > maxVectorStops ) return scanScalarFirstOf(first,last,stops,n);
+    __m256i needles[maxVectorStops];
+    for( size_t i = 0; i < n; ++i ) needles[i] = _mm256_set1_epi8(stops[i]);
+    while( last - first >= 32 ) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)first);
+        __m256i found = _mm256_setzero_si256();
+        for( size_t i = 0; i < n; ++i ) {
+            found = _mm256_or_si256(found,
+                _mm256_cmpeq_epi8(block,needles[i]));
+        }
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(found);
+        if( mask != 0 ) return first + __builtin_ctz(mask);
+        first += 32;
+    }
+    /* At most 31 bytes left, let the SSE2 loop pick up the rest. */
+    return scanSSE2FirstOf(first,last,stops,n);
+}
+
+#endif
+
+scanMode activeMode = scanAuto;
+scanFunc activeScan = NULL;
+
+} // anonymous
+
+
+namespace tero {
+
+scanMode selectScanMode( scanMode mode ) {
+#ifdef SIMDSCAN_X86
+    __builtin_cpu_init();
+    bool hasAVX2 = __builtin_cpu_supports("avx2");
+    bool hasSSE2 = __builtin_cpu_supports("sse2");
+    if( mode == scanAuto ) mode = scanAVX2;
+    if( mode == scanAVX2 && !hasAVX2 ) mode = scanSSE2;
+    if( mode == scanSSE2 && !hasSSE2 ) mode = scanScalar;
+    switch( mode ) {
+    case scanAVX2:
+        activeScan = scanAVX2FirstOf;
+        break;
+    case scanSSE2:
+        activeScan = scanSSE2FirstOf;
+        break;
+    default:
+        mode = scanScalar;
+        activeScan = scanScalarFirstOf;
+        break;
+    }
+#else
+    mode = scanScalar;
+    activeScan = scanScalarFirstOf;
+#endif
+    activeMode = mode;
+    return activeMode;
+}
+
+
+scanMode currentScanMode() {
+    if( activeScan == NULL ) selectScanMode(scanAuto);
+    return activeMode;
+}
+
+
+const char *scanFirstOf( const char *first, const char *last,
+    const char *stops, size_t n )
+{
+    if( activeScan == NULL ) selectScanMode(scanAuto);
+    return activeScan(first,last,stops,n);
+}
+
+}
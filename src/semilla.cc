@@ -24,7 +24,10 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include <unistd.h>
+#include <sys/wait.h>
+#include <cerrno>
 #include <cstdlib>
+#include <map>
 #include <sstream>
 #include <iostream>
 #include <boost/filesystem.hpp>
@@ -43,6 +46,7 @@
 #include "webserve.hh"
 #include "cppfiles.hh"
 #include "shfiles.hh"
+#include "fastcgi.hh"
 
 /** Main executable
 
@@ -71,6 +75,407 @@ extern dispatchDoc semDocs;
 
 }
 
+namespace {
+
+/** Serve requests forwarded by a web server through the FastCGI protocol
+    until the listening socket is closed.
+
+    Registrations, the dispatch table, compiled regular expressions
+    and the (name,value) pairs from the command-line and config file
+    are loaded once and stay alive across requests. Only the per-request
+    state is reset before each request.
+*/
+void fastcgiServe( tero::session& s, std::ostream& mainout,
+    tero::responsebuf& response )
+{
+    using namespace std;
+    using namespace tero;
+
+    boost::filesystem::path initialPath = boost::filesystem::current_path();
+    fastcgi server;
+    while( server.accept() ) {
+        /* Per-request state: the output buffer, the http headers,
+           the current directory (not restored when a fetch throws),
+           the set of links found while generating the last page
+           and the contributors interned so far. */
+        mainout.clear();
+        httpHeaders = httpHeaderSet();
+        response.open(server.out(),true);
+        boost::filesystem::current_path(initialPath);
+        linkLight::allLinks.clear();
+        linkLight::currs.clear();
+        linkLight::nexts.clear();
+        contrib::clear();
+        s.out(mainout);
+        try {
+            s.restore(server.in());
+            semDocs.fetch(s,document.name,document.value(s));
+        } catch( exception& e ) {
+            cerr << e.what() << endl;
+            ++s.nErrs;
+            /* When part of the page was already sent, the error
+               page follows it. */
+            response.discard();
+            try {
+                s.insert("exception",e.what());
+                compose<except>(s,document.value(s));
+            } catch( exception& e ) {
+                response.discard();
+                mainout << "<html>" << endl;
+                mainout << html::head() << endl
+                        << "<title>It is really bad news...</title>" << endl
+                        << html::head::end << endl;
+                mainout << html::body() << endl << html::p() << endl
+                        << "caught exception: " << e.what() << endl
+                        << html::p::end << endl << html::body::end << endl;
+                mainout << "</html>" << endl;
+            }
+        }
+        response.finish(s.errors() ? 404 : 0);
+        server.finish(s.errors());
+    }
+}
+
+
+/** Dependencies of a cached page, as recorded the last time
+    the page was generated.
+*/
+struct cacheEntry {
+    typedef std::map<boost::filesystem::path,std::string> stampMap;
+
+    boost::filesystem::path cached;
+
+    /** stamp of each dependency at the time the page was generated. */
+    stampMap deps;
+
+    /** links to local files found in the page. */
+    tero::linkLight::linkSet links;
+};
+
+typedef std::map<tero::url,cacheEntry> cacheManifest;
+
+
+void writeUrl( std::ostream& ostr, const tero::url& u )
+{
+    ostr << u.protocol << '\t' << u.host << '\t' << u.port
+         << '\t' << u.pathname.string();
+}
+
+
+tero::url readUrl( const std::string& line, size_t first )
+{
+    std::vector<std::string> fields;
+    size_t last;
+    while( (last = line.find('\t',first)) != std::string::npos ) {
+        fields.push_back(line.substr(first,last - first));
+        first = last + 1;
+    }
+    fields.push_back(line.substr(first));
+    if( fields.size() != 4 ) return tero::url();
+    return tero::url(fields[0],fields[1],atoi(fields[2].c_str()),fields[3]);
+}
+
+
+/** Writes the *manifest* as text, one line per field, such that it can
+    also be used to send results from a worker process to its parent.
+*/
+void writeManifest( std::ostream& ostr, const cacheManifest& manifest )
+{
+    for( cacheManifest::const_iterator page = manifest.begin();
+         page != manifest.end(); ++page ) {
+        ostr << "page\t";
+        writeUrl(ostr,page->first);
+        ostr << '\n';
+        ostr << "cached\t" << page->second.cached.string() << '\n';
+        for( cacheEntry::stampMap::const_iterator
+                 dep = page->second.deps.begin();
+             dep != page->second.deps.end(); ++dep ) {
+            ostr << "dep\t" << dep->second << '\t'
+                 << dep->first.string() << '\n';
+        }
+        for( tero::linkLight::linkSet::const_iterator
+                 l = page->second.links.begin();
+             l != page->second.links.end(); ++l ) {
+            ostr << "link\t";
+            writeUrl(ostr,*l);
+            ostr << '\n';
+        }
+    }
+}
+
+
+/** Reads pages dependencies into *manifest*. "next" lines sent by
+    a worker process are added to *nexts*.
+*/
+void readManifest( std::istream& istr, cacheManifest& manifest,
+    tero::linkLight::linkSet& nexts )
+{
+    cacheEntry *entry = NULL;
+    std::string line;
+    while( std::getline(istr,line) ) {
+        size_t sep = line.find('\t');
+        if( sep == std::string::npos ) continue;
+        std::string key = line.substr(0,sep);
+        if( key == "page" ) {
+            entry = &manifest[readUrl(line,sep + 1)];
+            entry->deps.clear();
+            entry->links.clear();
+        } else if( key == "next" ) {
+            nexts.insert(readUrl(line,sep + 1));
+        } else if( entry != NULL ) {
+            if( key == "cached" ) {
+                entry->cached = line.substr(sep + 1);
+            } else if( key == "dep" ) {
+                size_t stampEnd = line.find('\t',sep + 1);
+                if( stampEnd != std::string::npos ) {
+                    entry->deps[line.substr(stampEnd + 1)]
+                        = line.substr(sep + 1,stampEnd - sep - 1);
+                }
+            } else if( key == "link" ) {
+                entry->links.insert(readUrl(line,sep + 1));
+            }
+        }
+    }
+}
+
+
+/** returns true when none of the dependencies of *entry* changed
+    since *cached* was generated.
+*/
+bool upToDate( const cacheEntry& entry,
+    const boost::filesystem::path& cached )
+{
+    if( entry.cached != cached || !boost::filesystem::exists(cached) ) {
+        return false;
+    }
+    for( cacheEntry::stampMap::const_iterator dep = entry.deps.begin();
+         dep != entry.deps.end(); ++dep ) {
+        if( tero::revisionsys::stamp(dep->first) != dep->second ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** Generate the cached page for the document *l* unless none of its
+    dependencies recorded in *previous* changed. The dependencies
+    of the page are recorded in *generated*.
+*/
+void cachePage( tero::session& s, tero::cachedUrlDecorator& successors,
+    const tero::url& l,
+    const cacheManifest& previous, cacheManifest& generated )
+{
+    using namespace std;
+    using namespace tero;
+
+    try {
+        s.reset();
+        s.insert(document.name,l.string(),session::cmdline);
+        boost::filesystem::path cached
+            = s.absCacheName(document.value(s));
+
+        cacheManifest::const_iterator prev = previous.find(l);
+        if( prev != previous.end() && upToDate(prev->second,cached) ) {
+            cout << "up-to-date " << cached << " (for "
+                 << l << ")" << endl;
+            /* Follow the links in the page as if it had been generated. */
+            for( linkLight::linkSet::const_iterator
+                     f = prev->second.links.begin();
+                 f != prev->second.links.end(); ++f ) {
+                if( linkLight::allLinks.find(*f) == linkLight::allLinks.end()
+                    && linkLight::currs.find(*f) == linkLight::currs.end() ) {
+                    linkLight::nexts.insert(*f);
+                }
+            }
+            generated[l] = prev->second;
+            return;
+        }
+
+        cout << "generating " << cached << " (for "
+             << l << ") ..." << endl;
+        unsigned int nErrs = s.nErrs;
+        session::dependencySet deps;
+        cacheEntry entry;
+        entry.cached = cached;
+        s.dependencies(&deps);
+        linkLight::pageLinks = &entry.links;
+        try {
+            /* \todo view != document, need to clear all session
+               variables except the ones loaded from config file. */
+            boost::filesystem::ofstream out;
+            s.createfile(out,cached);
+            successors.attach(out);
+            s.out(out);
+            semDocs.fetch(s,document.name,document.value(s));
+            successors.detach();
+            out.close();
+        } catch( ... ) {
+            s.dependencies(NULL);
+            linkLight::pageLinks = NULL;
+            s.unload();
+            throw;
+        }
+        s.dependencies(NULL);
+        linkLight::pageLinks = NULL;
+        /* Texts and xml documents mapped for this page are not shared
+           with the next one, release them before they add up. */
+        s.unload();
+
+        /* A page generated with errors is generated again next time. */
+        if( s.nErrs == nErrs ) {
+            for( session::dependencySet::const_iterator
+                     dep = deps.begin(); dep != deps.end(); ++dep ) {
+                entry.deps[*dep] = revisionsys::stamp(*dep);
+            }
+            generated[l] = entry;
+        }
+    } catch( exception& e ) {
+        cerr << "error: " << e.what() << endl;
+        ++s.nErrs;
+    }
+}
+
+
+/** Generate the cached pages for the current frontier level
+    (linkLight::currs) on *nbJobs* worker processes.
+
+    Each worker is forked with its own copy of the session, renders
+    one page out of *nbJobs* in the frontier level and sends back
+    the links it discovered, the dependencies of the pages it generated
+    and its fragment cache hits and misses through a pipe. Since all
+    workers start from the same set of visited links, merging their
+    discoveries into linkLight::nexts produces the same set as a serial run.
+
+    Workers are processes rather than threads because fetch callbacks
+    change the current directory of the process and decorators record
+    links in static sets.
+*/
+void cacheLevel( tero::session& s, tero::cachedUrlDecorator& successors,
+    int nbJobs, const cacheManifest& previous, cacheManifest& generated )
+{
+    using namespace std;
+    using namespace tero;
+
+    typedef std::vector<url> urlList;
+    urlList level(linkLight::begin(),linkLight::end());
+    if( nbJobs > (int)level.size() ) nbJobs = level.size();
+    if( nbJobs <= 1 ) {
+        for( urlList::const_iterator l = level.begin();
+             l != level.end(); ++l ) {
+            cachePage(s,successors,*l,previous,generated);
+        }
+        return;
+    }
+
+    /* Flush buffered output once, not once per worker. */
+    cout.flush();
+    cerr.flush();
+
+    typedef std::vector<std::pair<pid_t,int> > workerList;
+    workerList workers;
+    for( int w = 0; w < nbJobs; ++w ) {
+        int fds[2];
+        pid_t pid = -1;
+        if( pipe(fds) == 0 ) {
+            pid = fork();
+            if( pid < 0 ) {
+                close(fds[0]);
+                close(fds[1]);
+            }
+        }
+        if( pid == 0 ) {
+            close(fds[0]);
+            /* Only report errors from this level to the parent,
+               which already counts the errors of previous levels. */
+            unsigned int prevErrs = s.nErrs;
+            unsigned long prevHits = semDocs.cache().hits;
+            unsigned long prevMisses = semDocs.cache().misses;
+            cacheManifest pages;
+            for( size_t i = w; i < level.size(); i += nbJobs ) {
+                cachePage(s,successors,level[i],previous,pages);
+            }
+            std::stringstream results;
+            results << "fragments\t" << semDocs.cache().hits - prevHits
+                    << '\t' << semDocs.cache().misses - prevMisses << '\n';
+            for( linkLight::linkSet::const_iterator
+                     l = linkLight::nexts.begin();
+                 l != linkLight::nexts.end(); ++l ) {
+                results << "next\t";
+                writeUrl(results,*l);
+                results << '\n';
+            }
+            writeManifest(results,pages);
+            std::string buffer = results.str();
+            const char *p = buffer.c_str();
+            size_t left = buffer.size();
+            while( left > 0 ) {
+                ssize_t n = write(fds[1],p,left);
+                if( n < 0 && errno == EINTR ) continue;
+                if( n <= 0 ) {
+                    ++s.nErrs;
+                    break;
+                }
+                p += n;
+                left -= n;
+            }
+            close(fds[1]);
+            cout.flush();
+            cerr.flush();
+            _exit(std::min(s.nErrs - prevErrs,(unsigned int)255));
+        }
+        if( pid < 0 ) {
+            /* We could not fork, so this process does the work. */
+            cerr << "warning: cannot start worker (" << strerror(errno)
+                 << "), generating pages in-process." << endl;
+            for( size_t i = w; i < level.size(); i += nbJobs ) {
+                cachePage(s,successors,level[i],previous,generated);
+            }
+            continue;
+        }
+        close(fds[1]);
+        workers.push_back(std::make_pair(pid,fds[0]));
+    }
+
+    /* Merge the results of each worker. Reading the pipes in worker
+       order cannot deadlock since workers do not depend on each other. */
+    for( workerList::const_iterator w = workers.begin();
+         w != workers.end(); ++w ) {
+        std::string buffer;
+        char chunk[4096];
+        ssize_t n;
+        while( (n = read(w->second,chunk,sizeof(chunk))) != 0 ) {
+            if( n < 0 ) {
+                if( errno == EINTR ) continue;
+                break;
+            }
+            buffer.append(chunk,n);
+        }
+        close(w->second);
+        std::stringstream results(buffer);
+        /* The fragment cache of each worker is a copy of the parent's
+           one, so the worker reports the hits and misses it added. */
+        if( buffer.compare(0,10,"fragments\t") == 0 ) {
+            std::string key;
+            unsigned long hits = 0, misses = 0;
+            results >> key >> hits >> misses;
+            semDocs.cache().hits += hits;
+            semDocs.cache().misses += misses;
+        }
+        readManifest(results,generated,linkLight::nexts);
+        int status = 0;
+        while( waitpid(w->first,&status,0) < 0 && errno == EINTR );
+        if( WIFEXITED(status) ) {
+            s.nErrs += WEXITSTATUS(status);
+        } else {
+            cerr << "error: worker " << w->first << " died." << endl;
+            ++s.nErrs;
+        }
+    }
+}
+
+} // anonymous
+
 int main( int argc, char *argv[] )
 {
     using namespace std;
@@ -78,7 +483,9 @@ int main( int argc, char *argv[] )
     using namespace boost::filesystem;
     using namespace tero;
 
-    std::stringstream mainout;
+    /* Pages are streamed to stdout once the response buffer fills up. */
+    responsebuf response;
+    std::ostream mainout(&response);
     session s("semillaId",mainout);
     s.privileged(false);
 
@@ -86,13 +493,16 @@ int main( int argc, char *argv[] )
 		/* parse command line arguments */
 		options_description genOptions("caching");
 		genOptions.add_options()
-			("cache","produce a static cache out of the dynamic content");
+			("cache","produce a static cache out of the dynamic content")
+			("fastcgi","serve requests forwarded by a web server through the FastCGI protocol on the socket passed as standard input");
+		genOptions.add(jobs.option());
 		s.opts.add(genOptions);
 		s.visible.add(genOptions);
 		docAddSessionVars(s.opts,s.visible);
 		changelistAddSessionVars(s.opts,s.visible);
 		composerAddSessionVars(s.opts,s.visible);
 		postAddSessionVars(s.opts,s.visible);
+		blogAddSessionVars(s.opts,s.visible);
 		projectAddSessionVars(s.opts,s.visible);
 		calendarAddSessionVars(s.opts,s.visible);
 		logAddSessionVars(s.opts,s.visible);
@@ -103,11 +513,15 @@ int main( int argc, char *argv[] )
 		s.restore(argc,argv);
 		
 		bool genCache = false;
+		bool persistent = false;
 		if( !s.runAsCGI() ) {
 			for( int i = 1; i < argc; ++i ) {
 				if( strncmp(argv[i],"--cache",7) == 0 ) {
 					genCache = true;
 				}
+				if( strncmp(argv[i],"--fastcgi",9) == 0 ) {
+					persistent = true;
+				}
 				if( strncmp(argv[i],"--version",9) == 0 ) {
                     std::cout << "Version 0.4" << std::endl;
                     return 0;
@@ -115,7 +529,9 @@ int main( int argc, char *argv[] )
 			}
 		}
 		
-		if( genCache ) {
+		if( persistent ) {
+			fastcgiServe(s,mainout,response);
+		} else if( genCache ) {
             /* XXX root is first link in set. */
 			cachedUrlDecorator successors(s, s.abspath(*s.inputs.begin()));
 			for( session::inputsType::const_iterator
@@ -123,50 +539,46 @@ int main( int argc, char *argv[] )
 				linkLight::nexts.insert(*inp);
 			}
 			
+			/* Pages whose dependencies did not change since the previous
+			   run are not generated again. */
+			path manifestPath = cacheTop.value(s) / ".semilla.deps";
+			cacheManifest previous, generated;
+			{
+				boost::filesystem::ifstream manifest(manifestPath);
+				linkLight::linkSet unused;
+				readManifest(manifest,previous,unused);
+			}
+
+			int nbJobs = jobs.value(s);
 			while( !linkLight::empty() ) {
 				linkLight::clear();
-				for( linkLight::linkSet::const_iterator l = linkLight::begin();
-					 l != linkLight::end(); ++l ) {
-					try {
-						s.reset();
-						s.insert(document.name,l->string(),session::cmdline);
-						boost::filesystem::path cached
-							= s.absCacheName(document.value(s));
-						cout << "generating " << cached << " (for "
-							 << *l << ") ..." << endl;
-						/* \todo view != document, need to clear all session
-						   variables except the ones loaded from config file. */
-						boost::filesystem::ofstream out;
-						s.createfile(out,cached);
-						successors.attach(out);
-						s.out(out);
-						semDocs.fetch(s,document.name,document.value(s));
-						successors.detach();
-						out.close();
-					} catch( exception& e ) {
-						cerr << "error: " << e.what() << endl;
-						++s.nErrs;
-					}
-				}
+				cacheLevel(s,successors,nbJobs,previous,generated);
 			}
+
+			path tmpPath = manifestPath.string() + ".tmp";
+			boost::filesystem::ofstream manifest;
+			s.createfile(manifest,tmpPath);
+			writeManifest(manifest,generated);
+			manifest.close();
+			rename(tmpPath,manifestPath);
+			cout << "fragment cache: " << semDocs.cache().hits << " hits, "
+				 << semDocs.cache().misses << " misses" << endl;
 		}  else {
 			/* When we run as CGI, we will assume the path is a url relative
 			   to siteTop while running in shell command-line mode, we will
 			   assume it is a regular filename. */
+			response.open(cout,s.runAsCGI());
 			semDocs.fetch(s,document.name,document.value(s));
-			if( s.runAsCGI() ) {
-				cout << httpHeaders
-					.contentType()
-					.status(s.errors() ? 404 : 0);
-			}
-			cout << mainout.str();
+			response.finish(s.errors() ? 404 : 0);
 		}
 		
     } catch( exception& e ) {
 		try {
 			std::cerr << e.what() << std::endl;
 			s.insert("exception",e.what());
+			response.discard();
 			compose<except>(s,document.value(s));
+			response.finish(404);
 		} catch( exception& e ) {
 			/* Something went really wrong if we either get here. */
 			cout << httpHeaders.contentType().status(404);
@@ -89,7 +89,7 @@ fetchEntry entries[] = {
 	  noAuth|noPipe, compose<basePage>, NULL, NULL },
 
     { "bytags", boost::regex(".*/blog/.*"),
-	  noAuth|noPipe, blogTagLinks<blogPat>, NULL, NULL },
+	  noAuth|noPipe|whenCache, blogTagLinks<blogPat>, NULL, NULL },
     { "check", boost::regex(".*\\.c"),
 	  noAuth|noPipe, NULL, NULL, checkfileFetch<cppChecker> },
     { "check", boost::regex(".*\\.h"),
@@ -147,7 +147,7 @@ fetchEntry entries[] = {
     { "content", boost::regex(".*/blog/tags-.*"),
       noAuth|noPipe, blogByIntervalTags<docPage,blogPat>, NULL, NULL },
     { "content", boost::regex(".*/blog/tags/"),
-	  noAuth|noPipe, blogTagLinks<blogPat>, NULL, NULL },
+	  noAuth|noPipe|whenCache, blogTagLinks<blogPat>, NULL, NULL },
 
     { "content", boost::regex(".*/blog/archive-.*"),
       noAuth|noPipe, blogByIntervalDate<docPage,blogPat>, NULL, NULL },
@@ -198,7 +198,7 @@ fetchEntry entries[] = {
     { "date", boost::regex(".*/tests/.+\\.xml"),
       noAuth|noPipe, junitDate, NULL, NULL },
     { "dates", boost::regex(".*/blog/.*"),
-	  noAuth|noPipe, blogDateLinks<blogPat>, NULL, NULL },
+	  noAuth|noPipe|whenCache, blogDateLinks<blogPat>, NULL, NULL },
 
     /* Documents split a page into a *content* and *sidebar* sections.
        Both are based on the context as specified by url. */
@@ -255,17 +255,37 @@ fetchEntry entries[] = {
     { "feed", boost::regex(".*\\.git/index\\.feed"),
       noAuth|noPipe, feedRepository<htmlwriter>, NULL, NULL },
     { "feed", boost::regex(".*/log/index\\.feed"),
-      noAuth|noPipe, logSummaries<htmlwriter>, NULL, NULL },
+      noAuth|noPipe|whenCache, logSummaries<htmlwriter>, NULL, NULL },
     { "feed", boost::regex(".*/index\\.feed"),
-      noAuth|noPipe, feedLatestPosts<htmlwriter,feed>, NULL, NULL },
+      noAuth|noPipe|whenCache, feedLatestPosts<htmlwriter,feed>, NULL, NULL },
     { "feed", boost::regex("/"),
-      noAuth|noPipe, htmlSiteAggregate<feed>, NULL, NULL },
+      noAuth|noPipe|whenCache, htmlSiteAggregate<feed>, NULL, NULL },
     { "history", boost::regex(".*dws\\.xml"),
       noAuth|noPipe, feedRepository<htmlwriter>, NULL, NULL },
     /* Widget to display the history of a file under revision control
        in the absence of a more restrictive pattern. */
     { "history", boost::regex(".*"),
-      noAuth|noPipe, changehistoryFetch, NULL, NULL },
+      noAuth|noPipe|whenCache, changehistoryFetch, NULL, NULL },
+
+    /* Posts generated by feedContent. Documents without a post
+       callback are assembled through their title, author, date
+       and content callbacks instead. */
+    { "post", boost::regex(".*/log/"),
+      noAuth|noPipe, NULL, NULL, NULL, NULL },
+    { "post", boost::regex(".*\\.blog"),
+      noAuth|noPipe, NULL, NULL, NULL, NULL },
+    { "post", boost::regex(".*/blog/"),
+      noAuth|noPipe, NULL, NULL, NULL, NULL },
+    { "post", boost::regex(".*\\.book"),
+      noAuth|noPipe, NULL, NULL, NULL, docbookPost },
+    { "post", boost::regex(".*\\.todo"),
+      noAuth|noPipe, NULL, NULL, NULL, todoPost },
+    { "post", boost::regex(".*dws\\.xml"),
+      noAuth|noPipe, NULL, NULL, NULL, projectPost },
+    { "post", boost::regex(".*/tests/.+\\.xml"),
+      noAuth|noPipe, NULL, NULL, NULL, junitPost },
+    { "post", boost::regex(".*"),
+      noAuth|noPipe, NULL, NULL, NULL, filePost },
 
     /* just print the value of *name* */
     { "print", boost::regex(".*"),
@@ -160,7 +160,7 @@ std::string session::sessionName;
 
 session::session( const std::string& sn,
     std::ostream& o )
-	: sessionId(""), ostr(&o), nErrs(0), feeds(NULL)
+	: sessionId(""), ostr(&o), deps(NULL), nErrs(0), feeds(NULL)
 {
     sessionName = sn;
 
@@ -286,6 +286,7 @@ slice<char> session::loadtext( const boost::filesystem::path& pathname )
     using namespace boost::filesystem;
     using namespace boost::system::errc;
 
+    depends(pathname);
     textMap::const_iterator found = texts.find(pathname);
     if( found != texts.end() ) {
         return found->second;
@@ -296,9 +297,20 @@ slice<char> session::loadtext( const boost::filesystem::path& pathname )
 }
 
 
+void session::unload()
+{
+    for( xmlMap::iterator x = xmls.begin(); x != xmls.end(); ++x ) {
+        delete x->second;
+    }
+    xmls.clear();
+    texts.clear();
+}
+
+
 RAPIDXML::xml_document<>*
 session::loadxml( const boost::filesystem::path& p )
 {
+    depends(p);
     xmlMap::const_iterator found = xmls.find(p);
     if( found != xmls.end() ) {
         return found->second;
@@ -385,14 +397,14 @@ void session::insert( const std::string& name, const std::string& value,
 }
 
 
-void session::reset()
+void session::reset( sourceType from )
 {
     typedef std::list<variables::iterator> eraseSet;
 
     eraseSet erased;
     for( variables::iterator  nv = vars.begin();
          nv != vars.end(); ++nv ) {
-        if( nv->second.source >= unknown ) {
+        if( nv->second.source >= from ) {
             erased.push_back(nv);
         }
     }
@@ -525,7 +537,7 @@ session::abspath( const url& relative ) const
 }
 
 
-void session::restore( int argc, char *argv[] )
+void session::restoreRequest( std::istream *body )
 {
     using namespace boost;
     using namespace boost::system;
@@ -549,6 +561,83 @@ void session::restore( int argc, char *argv[] )
     positional_options_description pd;
     pd.add(document.name, -1);
 
+    /* 4. Parameters passed in environment variables through the CGI invokation
+       are then parsed. */
+    variables_map cgiParams;
+    cgi_parser parser;
+    parser.options(opts);
+    parser.positional(pd);
+    if( body != NULL ) parser.input(*body);
+    boost::program_options::store(parser.run(),cgiParams);
+
+    /* 5. If a "sessionName" and a derived file exists, the (name,value) pairs
+       in that session file are added to the session. */
+   sessionId = valueOf(sessionName);
+   if( sessionId.empty() ) {
+       cgi_parser::querySet::const_iterator sid 
+           = parser.query.find(sessionName);
+       if( sid != parser.query.end() ) {
+           sessionId = sid->second;
+       }
+   }
+
+   if( exists() ) {
+       load(opts,stateFilePath(),sessionfile);
+   }
+
+   /* 6. The parsed CGI parameters are added to the session. */
+   for( std::map<std::string,std::string>::const_iterator
+            p = parser.query.begin(); p != parser.query.end(); ++p ) {
+       insert(p->first,p->second,queryenv);
+   }
+
+   /* set the username to the value of LOGNAME in case no information
+      can be retrieved for the session. It helps with keeping track
+      of time spent with a shell command line. */
+   session::variables::const_iterator v = vars.find("username");
+   if( v == vars.end() ) {
+       char *logName = getenv("LOGNAME");
+       if( logName != NULL ) {
+           insert("username",logName);
+       }
+   }
+
+   /* Append a trailing '/' if the document is a directory
+      to match Apache's rewrite rules. */
+   std::string docname = document.value(*this).string();
+   if( boost::filesystem::is_directory(docname)
+       && (docname.size() == 0
+           || docname[docname.size() - 1] != '/') ) {
+       sourceType source = unknown;
+       variables::const_iterator iter = vars.find(document.name);
+       if( iter != vars.end() ) {
+           source = iter->second.source;
+       }
+       insert(document.name,docname + '/',source);
+   }
+}
+
+
+void session::restore( std::istream& body )
+{
+    reset(sessionfile);
+    unload();
+    sessionId = "";
+    nErrs = 0;
+    restoreRequest(&body);
+}
+
+
+void session::restore( int argc, char *argv[] )
+{
+    using namespace boost;
+    using namespace boost::system;
+    using namespace boost::filesystem;
+    using namespace boost::program_options;
+
+    positional_options_description pd;
+    pd.add(document.name, -1);
+
     /* 1. The command-line arguments are added to the session. */
     {
         variables_map params;
@@ -614,59 +703,8 @@ void session::restore( int argc, char *argv[] )
        are added to the session. */
     load(opts,config,configfile);
 
-    /* 4. Parameters passed in environment variables through the CGI invokation
-       are then parsed. */
-    variables_map cgiParams;
-    cgi_parser parser;
-    parser.options(opts);
-    parser.positional(pd);
-    boost::program_options::store(parser.run(),cgiParams);
-
-    /* 5. If a "sessionName" and a derived file exists, the (name,value) pairs
-       in that session file are added to the session. */
-   sessionId = valueOf(sessionName);
-   if( sessionId.empty() ) {
-       cgi_parser::querySet::const_iterator sid 
-           = parser.query.find(sessionName);
-       if( sid != parser.query.end() ) {
-           sessionId = sid->second;
-       }
-   }
-
-   if( exists() ) {
-       load(opts,stateFilePath(),sessionfile);
-   }
-
-   /* 6. The parsed CGI parameters are added to the session. */
-   for( std::map<std::string,std::string>::const_iterator
-            p = parser.query.begin(); p != parser.query.end(); ++p ) {
-       insert(p->first,p->second,queryenv);
-   }
-
-   /* set the username to the value of LOGNAME in case no information
-      can be retrieved for the session. It helps with keeping track
-      of time spent with a shell command line. */
-   session::variables::const_iterator v = vars.find("username");
-   if( v == vars.end() ) {
-       char *logName = getenv("LOGNAME");
-       if( logName != NULL ) {
-           insert("username",logName);
-       }
-   }
-
-   /* Append a trailing '/' if the document is a directory
-      to match Apache's rewrite rules. */
-   std::string docname = document.value(*this).string();
-   if( boost::filesystem::is_directory(docname)
-       && (docname.size() == 0
-           || docname[docname.size() - 1] != '/') ) {
-       sourceType source = unknown;
-       variables::const_iterator iter = vars.find(document.name);
-       if( iter != vars.end() ) {
-           source = iter->second.source;
-       }
-       insert(document.name,docname + '/',source);
-   }
+    /* 4. to 6. */
+    restoreRequest(NULL);
 
    if( valueOf(cacheTop.name).empty() ) {
        /* does not use cacheTop.value(*this) in order to avoid throwing
@@ -47,33 +47,49 @@ boost::filesystem::path covPath( session& s, const std::string& projectName ) {
 }
 
 
+bool lintSource( session& s, const boost::filesystem::path& pathname,
+    boost::filesystem::path& key, boost::filesystem::path& log )
+{
+    session::variables::const_iterator look = s.find(srcTop.name);
+    if( !s.found(look) || look->second.value.empty() ) return false;
+    boost::filesystem::path top = srcTop.value(s);
+    if( !s.prefix(top,pathname) ) return false;
+    boost::filesystem::path rel = s.subdirpart(top,pathname);
+    boost::filesystem::path::iterator part = rel.begin();
+    if( part == rel.end() ) return false;
+    std::string proj = part->string();
+    if( ++part == rel.end() ) return false;
+    key = s.subdirpart(top / proj,pathname);
+    log = lintPath(s,proj);
+    return true;
+}
+
+
 void shFetch( session& s, std::istream& in, const url& name )
 {
-    /* XXX re-enable lint additions when we figure out how to do
-       that with only a istream... */
+    boost::filesystem::path key, log;
+    bool annotated = lintSource(s,s.abspath(name),key,log);
 #if 0
-	std::string proj = projectName(s,pathname);
-
-	/* order of declaration is important here. */
+    /* XXX re-enable coverage additions. */
 	coverageAnnotate coverage(pathname,covPath(s,proj));
-	lintAnnotate lint(s,s.subdirpart(srcTop.value(s) / proj,pathname),
-					  lintPath(s,proj));
 #endif
+    /* order of declaration is important here. */
+    lintAnnotate lint(key,log);
     htmlEscaper leftLinkText;
     decoratorChain leftChain;
 #if 0
     if( !coverage.empty() ) {
         leftChain.push_back(coverage);
     }
-    if( !lint.empty() ) {
+#endif
+    if( annotated && !lint.empty() ) {
         leftChain.push_back(lint);
     }
-#endif
     leftChain.push_back(leftLinkText);
 
     htmlEscaper rightLinkText;
-    text sh(leftChain,rightLinkText);
-    sh.fetch(s,in);
+    text sh(leftChain,rightLinkText,"escape");
+    sh.fetch(s,in,name);
 }
 
 
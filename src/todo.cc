@@ -412,6 +412,24 @@ namespace {
 
     char titleMeta[] = "title";
 
+    /** Records the subject of the first post that goes through. */
+    class firstSubject : public passThruFilter {
+    public:
+        bool found;
+        std::string subject;
+
+        explicit firstSubject( postFilter *n )
+            : passThruFilter(n), found(false) {}
+
+        virtual void filters( const post& p ) {
+            if( !found ) {
+                subject = p.title;
+                found = true;
+            }
+            next->filters(p);
+        }
+    };
+
 } // anonymous
 
 
@@ -456,4 +474,23 @@ todoWriteHtmlFetch( session& s, const url& name )
     parser.fetchFile(s, s.abspath(name));
 }
 
+
+void todoPost( session& s, post& p, const url& name )
+{
+    boost::filesystem::path pathname = s.abspath(name);
+    std::stringstream content;
+    htmlwriter writer(content);
+    firstSubject item(&writer);
+    mailParser parser(item);
+    parser.fetchFile(s, pathname);
+
+    /* same title as todoMeta. */
+    p.title = item.found ?
+        std::string("(no title) - ") + item.subject : fileTitle(s,name);
+    p.author = fileAuthor(s,pathname);
+    p.time = fileTime(pathname);
+    std::string text = content.str();
+    p.content.adopt(text);
+}
+
 }
@@ -59,7 +59,7 @@ std::string uriEncode( const std::string& s ) {
 
 
 httpHeaderSet::httpHeaderSet()
-    : firstTime(true), contentLengthValue(0), statusCode(0)
+    : firstTime(true), changes(0), contentLengthValue(0), statusCode(0)
 {
 }
 
@@ -69,6 +69,7 @@ httpHeaderSet& httpHeaderSet::contentDisposition( const std::string& value,
 {
     contentDispositionValue = value;
     contentDispositionFilename = filename;
+    ++changes;
     return *this;    
 }
 
@@ -78,17 +79,20 @@ httpHeaderSet& httpHeaderSet::contentType( const std::string& value,
 {
     contentTypeValue = value;
     contentTypeCharset = charset;
+    ++changes;
     return *this;
 }
 
 httpHeaderSet& httpHeaderSet::contentLength( size_t length ) 
 {
     contentLengthValue = length;
+    ++changes;
     return *this;
 }
 
 httpHeaderSet& httpHeaderSet::location( const url& v ) {
     locationValue = v;
+    ++changes;
     return *this;
 }
 
@@ -96,6 +100,7 @@ httpHeaderSet& httpHeaderSet::location( const url& v ) {
 httpHeaderSet& httpHeaderSet::refresh( size_t delay, const url& v ) {
     refreshDelay = delay;
     refreshUrl = v;
+    ++changes;
     return *this;
 }
 
@@ -108,6 +113,7 @@ httpHeaderSet::setCookie( const std::string& name,
     setCookieName = name;
     setCookieValue = value;
     setCookieLifetime = exp;
+    ++changes;
     return *this;
 }
 
@@ -115,12 +121,128 @@ httpHeaderSet::setCookie( const std::string& name,
 httpHeaderSet& httpHeaderSet::status( unsigned int s )
 {
     statusCode = s;
+    ++changes;
     return *this;
 }
 
 
 httpHeaderSet httpHeaders;
 
+
+responsebuf::responsebuf( size_t bufferSize )
+    : dest(NULL), withHeaders(false), state(buffering),
+      started(false), startVersion(0), buffer(bufferSize)
+{
+}
+
+
+void responsebuf::open( std::ostream& d, bool headers )
+{
+    dest = &d;
+    withHeaders = headers;
+    state = buffering;
+    started = false;
+    held.clear();
+    setp(NULL, NULL);
+}
+
+
+void responsebuf::commit( unsigned int status )
+{
+    if( withHeaders ) {
+        if( status > 0 ) httpHeaders.status(status);
+        *dest << httpHeaders.contentType();
+    }
+}
+
+
+void responsebuf::drain()
+{
+    if( !dest ) {
+        /* no response opened, nowhere to write to. */
+        setp(&buffer[0], &buffer[0] + buffer.size());
+        return;
+    }
+    if( state == buffering ) {
+        if( httpHeaders.version() != startVersion ) {
+            state = buffered;
+        } else {
+            commit(0);
+            startVersion = httpHeaders.version();
+            state = streaming;
+        }
+    }
+    if( state == streaming ) {
+        dest->write(pbase(), pptr() - pbase());
+    } else {
+        held.append(pbase(), pptr());
+    }
+    setp(&buffer[0], &buffer[0] + buffer.size());
+}
+
+
+responsebuf::int_type responsebuf::overflow( int_type c )
+{
+    if( !started ) {
+        started = true;
+        startVersion = httpHeaders.version();
+        setp(&buffer[0], &buffer[0] + buffer.size());
+    } else {
+        drain();
+    }
+    if( !traits_type::eq_int_type(c, traits_type::eof()) ) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+
+int responsebuf::sync()
+{
+    /* Flushes in the middle of the body do not commit the headers,
+       as std::endl would otherwise. */
+    if( state == streaming && pptr() > pbase() ) {
+        drain();
+    }
+    return 0;
+}
+
+
+bool responsebuf::discard()
+{
+    if( state == streaming ) return false;
+    state = buffering;
+    started = false;
+    held.clear();
+    setp(NULL, NULL);
+    return true;
+}
+
+
+void responsebuf::finish( unsigned int status )
+{
+    if( !dest ) return;
+    if( state == streaming ) {
+        if( pptr() > pbase() ) dest->write(pbase(), pptr() - pbase());
+        if( withHeaders
+            && (status > 0 || httpHeaders.version() != startVersion) ) {
+            std::cerr << "warning: http headers changed after they were sent"
+                      << std::endl;
+        }
+    } else {
+        commit(status);
+        dest->write(held.data(), held.size());
+        if( started ) dest->write(pbase(), pptr() - pbase());
+    }
+    dest->flush();
+    dest = NULL;
+    state = buffering;
+    started = false;
+    held.clear();
+    setp(NULL, NULL);
+}
+
 emptyParaHackType emptyParaHack;
 
 url::url( const std::string& name ) {
@@ -282,10 +404,16 @@ basic_cgi_parser::run() {
     long len;
     char *lenstr = getenv("CONTENT_LENGTH");
     if( lenstr != NULL && sscanf(lenstr,"%ld",&len) == 1 ) {
-	char *buffer;
-	char input[len];
-	buffer = fgets(input, len + 1, stdin);
-	parseCGILine(query,buffer,len);
+	if( istr != NULL ) {
+	    std::vector<char> input(len + 1);
+	    istr->read(&input[0],len);
+	    parseCGILine(query,&input[0],istr->gcount());
+	} else {
+	    char *buffer;
+	    char input[len];
+	    buffer = fgets(input, len + 1, stdin);
+	    parseCGILine(query,buffer,len);
+	}
     }
 
     /* initialize matching options */
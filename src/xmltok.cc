@@ -52,6 +52,26 @@ const char *xmlTokenTitles[] = {
 
 #define advance(state) { trans = &&state; goto advancePointer; }
 
+/* Jumps over a run of characters that do not change the current state
+   (nor trigger an end-of-line) so the state loop resumes on the last 
+   character before one of *stops*. */
+#define skipTo(stops) { \
+	const char *q = scanFirstOf(p,line + n,stops,sizeof(stops)); \
+	if( q > p + 1 ) p = q - 1; \
+    }
+
+namespace {
+
+/* Characters a plain text run stops on. The last four are handled
+   in advancePointer. */
+const char contentStops[] = { '<', '\\', '\r', '\n', '\0' };
+
+/* Characters an attribute value stops on. Both quoted forms end
+   on a double-quote. */
+const char attValueStops[] = { '"', '\\', '\r', '\n', '\0' };
+
+} // anonymous
+
 bool nameStartChar( int c ) {
     return isalpha(c);
 }
@@ -63,7 +83,9 @@ bool nameChar( int c ) {
 size_t xmlTokenizer::tokenize( const char *line, size_t n )
 {
     const char *p = line;
-    int last;
+    int last = 0;
+    /* State that examines the character at *p*. */
+    void *entered = trans;
     first = 0;
 
     if( n == 0 ) return 0;
@@ -75,6 +97,10 @@ advancePointer:
 		if( last > first && listener != NULL ) {
 			listener->token(tok,line,first,last,true);
 		}
+		/* The transition was decided on the lookahead character,
+		   which is also the first character of the next call. It
+		   is examined again from the state that looked at it. */
+		trans = entered;
 		return last;
 	}
     switch( *p ) {
@@ -96,6 +122,7 @@ advancePointer:
 		goto eolAdvancePointer;
     }
 	++p;
+	entered = trans;
     goto *trans;
 
  eolAdvancePointer:
@@ -107,6 +134,7 @@ advancePointer:
 		return last;
 	}
 	++p;
+	entered = trans;
     goto *trans;
 
  esceol:
@@ -124,6 +152,7 @@ advancePointer:
 	/* not an escaped newline */
 	trans = savedtrans;
 	savedtrans = NULL;
+	entered = trans;
 	goto *trans;
 
  eolmacwin:
@@ -152,12 +181,18 @@ advancePointer:
 
 attValueDouble:
     /* AttValue ::= '"' ([^<&"] | Reference)* '"' */
-    if( *p != '"' ) advance(attValueDouble);
+    if( *p != '"' ) {
+	skipTo(attValueStops);
+	advance(attValueDouble);
+    }
     advance(tag);
 
 attValueSingle:
     /* AttValue ::= "'" ([^<&'] | Reference)* "'" */
-    if( *p != '"' ) advance(attValueSingle);
+    if( *p != '"' ) {
+	skipTo(attValueStops);
+	advance(attValueSingle);
+    }
     advance(tag);
 
 comment:
@@ -165,7 +200,10 @@ comment:
     advance(comment);
 
 content:
-    if( *p != '<' ) advance(content);
+    if( *p != '<' ) {
+	skipTo(contentStops);
+	advance(content);
+    }
     goto token;
 
 endComment: